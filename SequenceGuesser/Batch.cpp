@@ -0,0 +1,169 @@
+#include "stdafx.h"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <iomanip>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Batch.h"
+#include "ResultCache.h"
+#include "Solver.h"
+#include "WorkStealingPool.h"
+using namespace std;
+
+// How many lines we read ahead of the workers, per worker.
+#define JOBS_QUEUED_PER_WORKER	4
+
+// A line from the input waiting to be solved.
+typedef struct {
+	long long	LineNum;
+	string		Line;
+} sBatchJob;
+
+// The lines waiting for a worker. It's bounded so that the reader blocks, rather than reading the whole input into memory,
+// when the input arrives faster than we can solve it.
+typedef struct {
+	mutex				Lock;
+	condition_variable	NotEmpty;
+	condition_variable	NotFull;
+	deque<sBatchJob>	Jobs;
+	size_t				Capacity;
+	bool				NoMoreJobs;
+} sJobQueue;
+
+static bool PopJob(sJobQueue *pQueue, sBatchJob *pJob)
+{
+	unique_lock<mutex> Guard(pQueue->Lock);
+
+	pQueue->NotEmpty.wait(Guard, [pQueue]() { return !pQueue->Jobs.empty() || pQueue->NoMoreJobs; });
+	if (pQueue->Jobs.empty())
+		return false;
+	*pJob = move(pQueue->Jobs.front());
+	pQueue->Jobs.pop_front();
+	pQueue->NotFull.notify_one();
+	return true;
+}
+
+static void PushJob(sJobQueue *pQueue, sBatchJob& Job)
+{
+	unique_lock<mutex> Guard(pQueue->Lock);
+
+	pQueue->NotFull.wait(Guard, [pQueue]() { return pQueue->Jobs.size() < pQueue->Capacity; });
+	pQueue->Jobs.push_back(move(Job));
+	pQueue->NotEmpty.notify_one();
+}
+
+// The formula only contains digits, letters and "S(i-k)" so needs no escaping.
+string MakeResultRecord(long long LineNum, const int Seq[], int SeqLen, const sSolveResult *pResult)
+{
+	ostringstream Record;
+	int n;
+
+	Record << "{\"line\":" << LineNum;
+	if (SeqLen < 0)
+	{
+		Record << ",\"status\":\"parse_error\"}";
+		return Record.str();
+	}
+	if (SeqLen < 2)
+	{
+		Record << ",\"status\":\"invalid\"}";
+		return Record.str();
+	}
+	Record << ",\"sequence\":[";
+	for (n = 0; n < SeqLen; n++)
+		Record << (n > 0 ? "," : "") << Seq[n];
+	Record << "]";
+	if (pResult->Success)
+	{
+		Record << ",\"status\":\"solved\",\"next\":" << pResult->Formula.NextNum;
+		Record << ",\"formula\":\"" << FormulaToString(&pResult->Formula) << "\"";
+		Record << ",\"seeds\":" << pResult->NumSeeds << ",\"attempt\":" << pResult->Attempt;
+		// It fits, but there might be a simpler one we didn't get to.
+		if (pResult->Stopped)
+			Record << ",\"stopped\":true";
+	}
+	else if (pResult->Stopped)
+	{
+		// Nothing up to and including this step fits, but there might be something after it.
+		Record << ",\"status\":\"timeout\",\"searched_attempt\":" << pResult->Attempt << ",\"searched_max_retro_s\":" << pResult->MaxRetroS;
+	}
+	else
+	{
+		Record << ",\"status\":\"unsolved\"";
+	}
+	Record << ",\"ms\":" << fixed << setprecision(3) << pResult->ElapsedMs << "}";
+	return Record.str();
+}
+
+int RunBatch(istream& In, ostream& Out, int NumWorkers, sSolver *pSolver, const sSolveControl *pControl, sResultCache *pCache)
+{
+	sJobQueue Queue;
+	sBatchJob Job;
+	vector<thread> Workers;
+	vector<sSolver> Solvers;
+	mutex OutLock;
+	atomic<int> NumFailed(0);
+	int w;
+
+	if (NumWorkers < 1)
+		NumWorkers = 1;
+	// Share the threads out between the workers, so one hard sequence on its own still gets the whole machine.
+	Solvers.assign(NumWorkers, *pSolver);
+	for (w = 0; w < NumWorkers; w++)
+	{
+		Solvers[w].NumThreads = max(pSolver->NumThreads / NumWorkers, 1);
+		Solvers[w].Rejections.Rejected = 0;
+	}
+	Queue.Capacity = NumWorkers * JOBS_QUEUED_PER_WORKER;
+	Queue.NoMoreJobs = false;
+
+	for (w = 0; w < NumWorkers; w++)
+	{
+		Workers.emplace_back([&, w]()
+		{
+			sBatchJob MyJob;
+			sSolveResult Result;
+			int Seq[MAX_SEQ_LEN];
+			int SeqLen;
+			string Record;
+
+			while (PopJob(&Queue, &MyJob))
+			{
+				SeqLen = ParseSequence(MyJob.Line, Seq);
+				Result.Success = false;
+				Result.Stopped = false;
+				if (SeqLen >= 2)
+					SolveSequenceCached(pCache, &Solvers[w], Seq, SeqLen, false, pControl, &Result);
+				if (!Result.Success)
+					NumFailed++;
+				Record = MakeResultRecord(MyJob.LineNum, Seq, SeqLen, &Result);
+				lock_guard<mutex> Guard(OutLock);
+				Out << Record << endl;
+			}
+		});
+	}
+
+	for (Job.LineNum = 1; getline(In, Job.Line); Job.LineNum++)
+	{
+		// Skip blank lines without a record so that a pipe can be kept alive with them.
+		if (Job.Line.find_first_not_of(", \t\r") == string::npos)
+			continue;
+		PushJob(&Queue, Job);
+	}
+	{
+		lock_guard<mutex> Guard(Queue.Lock);
+		Queue.NoMoreJobs = true;
+	}
+	Queue.NotEmpty.notify_all();
+	for (w = 0; w < NumWorkers; w++)
+	{
+		Workers[w].join();
+		pSolver->Rejections.Rejected += Solvers[w].Rejections.Rejected;
+	}
+	return NumFailed;
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <iostream>
+#include <string>
+#include "ResultCache.h"
+#include "Solver.h"
+
+// Non-interactive mode. Reads sequences from In, one per line, and solves them on NumWorkers threads at once, looking them
+// up in pCache first if it isn't nullptr. pControl (nullptr for none) applies to each solve on its own.
+// Each worker has its own copy of *pSolver, with its threads shared out between them, so the workers have nothing to wait
+// for but the cache and the output. Their rejection stats are added to pSolver's when they've finished.
+// As each one is finished, a one-line JSON record of the result is written to Out, e.g.
+//	{"line":3,"sequence":[1,2,3,4],"status":"solved","next":5,"formula":"1 S(i-1) +","seeds":1,"attempt":0,"ms":0.041}
+// A solve which runs out of time without a formula gives e.g.
+//	{"line":4,"sequence":[3,1,4,1,5,9],"status":"timeout","searched_attempt":2,"searched_max_retro_s":0,"ms":1000.153}
+// meaning nothing up to that step fits, and one which finds a formula before the simpler ones are ruled out adds
+// "stopped":true to its record.
+// Records come out in the order the sequences are solved, not the order they were read, so use "line" to match them up.
+// Only a few lines are read ahead of the workers, so In can be an endless stream.
+// Returns the number of sequences which couldn't be solved or parsed.
+int RunBatch(std::istream& In, std::ostream& Out, int NumWorkers, sSolver *pSolver, const sSolveControl *pControl, sResultCache *pCache);
+
+// Builds the JSON record RunBatch() writes for line LineNum of its input, without a newline. A SeqLen of less than 2 means
+// the line wasn't a sequence, and -1 (from ParseSequence()) that it wasn't even numbers.
+std::string MakeResultRecord(long long LineNum, const int Seq[], int SeqLen, const sSolveResult *pResult);
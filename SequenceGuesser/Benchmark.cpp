@@ -0,0 +1,196 @@
+// A fixed set of sequences to time the search on, so we can tell whether a change made it faster or slower. Each sequence is
+// searched with each attempt on its own, the way SolveSequence() would search it at that attempt, and every search gets a
+// line of JSON on stdout, then there's a line with the totals (and, in a build with SEQUENCEGUESSER_STATS, the search's
+// stats). Run the same build options on the same machine to compare.
+
+#include "stdafx.h"
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#pragma comment(lib, "psapi.lib")
+#else
+#include <sys/resource.h>
+#endif
+#include "Lanes.h"
+#include "Samples.h"
+#include "SearchStats.h"
+#include "Solver.h"
+using namespace std;
+
+// The corpus is run at each of these lengths, as far as it goes, since short ones only have room for a few S(i-k). The
+// samples are just run as they are.
+static const int BenchLengths[] = { 5, 7, 9 };
+#define NUM_BENCH_LENGTHS ((int)(sizeof(BenchLengths) / sizeof(BenchLengths[0])))
+
+// The sequences besides the samples.
+static struct {
+	const char	*Kind;
+	int			SeqLen;
+	int			Seq[MAX_SEQ_LEN];
+} Corpus[] = {
+	{ "polynomial",		9,	1, 2, 5, 10, 17, 26, 37, 50, 65 },				// i^2 + 1.
+	{ "polynomial",		9,	0, 1, 3, 6, 10, 15, 21, 28, 36 },				// Triangular numbers.
+	{ "polynomial",		9,	1, 6, 15, 28, 45, 66, 91, 120, 153 },			// 2i^2 + 3i + 1.
+	{ "polynomial",		9,	0, 1, 8, 27, 64, 125, 216, 343, 512 },			// i^3.
+	{ "recurrence",		9,	1, 3, 8, 21, 55, 144, 377, 987, 2584 },			// 3S(i-1) - S(i-2).
+	{ "recurrence",		9,	1, 2, 5, 12, 29, 70, 169, 408, 985 },			// Pell numbers.
+	{ "recurrence",		9,	0, 1, 1, 3, 5, 11, 21, 43, 85 },				// Jacobsthal numbers, S(i-1) + 2S(i-2).
+	{ "recurrence",		9,	1, 1, 2, 4, 7, 13, 24, 44, 81 },				// Tribonacci numbers.
+	{ "unsolvable",		9,	3, 1, 4, 1, 5, 9, 2, 6, 5 },					// Digits of pi.
+	{ "unsolvable",		9,	2, 7, 1, 8, 2, 8, 1, 8, 2 },					// Digits of e.
+};
+#define NUM_CORPUS ((int)(sizeof(Corpus) / sizeof(Corpus[0])))
+
+// The most memory we've used so far, in KB.
+static unsigned long long PeakMemoryKB(void)
+{
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS Counters;
+
+	if (!GetProcessMemoryInfo(GetCurrentProcess(), &Counters, sizeof(Counters)))
+		return 0;
+	return Counters.PeakWorkingSetSize / 1024;
+#else
+	struct rusage Usage;
+
+	if (getrusage(RUSAGE_SELF, &Usage) != 0)
+		return 0;
+#ifdef __APPLE__
+	return Usage.ru_maxrss / 1024;	// Which is in bytes there.
+#else
+	return Usage.ru_maxrss;
+#endif
+#endif
+}
+
+typedef struct {
+	int					NumCases;
+	int					NumSolved;
+	double				Ms;
+	unsigned long long	Candidates;
+} sBenchTotals;
+
+// Searches the sequence with Attempt, with more and more S(i-k) like SolveSequence() does, and writes out how it went.
+static void BenchCase(sSolver *pSolver, const char *Kind, int Seq[], int SeqLen, int Attempt, sBenchTotals *pTotals)
+{
+	chrono::steady_clock::time_point StartTime;
+	sRejectionStats Before;
+	sFormula Formula;
+	ostringstream Record;
+	unsigned long long Candidates;
+	double Ms;
+	bool Found = false;
+	int MaxRetroS, n;
+
+	Before = pSolver->Rejections;
+	StartTime = chrono::steady_clock::now();
+	for (MaxRetroS = 0; !Found && MaxRetroS < SeqLen - 2; MaxRetroS++)
+	{
+		// S(i-1) is always allowed, so there would be nothing new to look at.
+		if (MaxRetroS != 1)
+			Found = GuessSequence(pSolver, Seq, SeqLen, Attempt, MaxRetroS, &Formula);
+	}
+	Ms = chrono::duration<double, milli>(chrono::steady_clock::now() - StartTime).count();
+	// Everything which got as far as being checked against the sequence, including the one which fitted.
+	Candidates = pSolver->Rejections.Rejected - Before.Rejected + (Found ? 1 : 0);
+
+	Record << "{\"kind\":\"" << Kind << "\",\"sequence\":[";
+	for (n = 0; n < SeqLen; n++)
+		Record << (n > 0 ? "," : "") << Seq[n];
+	Record << "],\"attempt\":" << Attempt;
+	if (Found)
+	{
+		Record << ",\"status\":\"solved\",\"next\":" << Formula.NextNum;
+		Record << ",\"formula\":\"" << FormulaToString(&Formula) << "\"";
+	}
+	else
+	{
+		Record << ",\"status\":\"unsolved\"";
+	}
+	Record << ",\"ms\":" << fixed << setprecision(3) << Ms << ",\"candidates\":" << Candidates;
+	Record << ",\"candidates_per_sec\":" << setprecision(0) << (Ms > 0 ? Candidates * 1000.0 / Ms : 0.0);
+	Record << ",\"peak_kb\":" << PeakMemoryKB() << "}";
+	cout << Record.str() << endl;
+
+	pTotals->NumCases++;
+	pTotals->NumSolved += Found ? 1 : 0;
+	pTotals->Ms += Ms;
+	pTotals->Candidates += Candidates;
+}
+
+// Searches the sequence with each attempt in turn.
+static void BenchAttempts(sSolver *pSolver, const char *Kind, const int Seq[], int SeqLen, int MaxAttempt, sBenchTotals *pTotals)
+{
+	int Copy[MAX_SEQ_LEN];
+	int Attempt;
+
+	// GuessSequence() doesn't take a const one.
+	memcpy(Copy, Seq, SeqLen * sizeof(Seq[0]));
+	for (Attempt = 0; Attempt <= MaxAttempt; Attempt++)
+		BenchCase(pSolver, Kind, Copy, SeqLen, Attempt, pTotals);
+}
+
+static void ShowUsage(void)
+{
+	cout << "Usage:" << endl;
+	cout << "  SequenceGuesserBenchmark [--threads N] [--max-attempt A]" << endl;
+	cout << "Searches each of the benchmark's sequences, at several lengths, with each attempt up to A (the last) using N" << endl;
+	cout << "threads (1), and writes a JSON record for each search, then one for the totals, to stdout." << endl;
+}
+
+int main(int argc, char *argv[])
+{
+	sBenchTotals Totals;
+	sSolver Solver;
+	int arg, s, l, NumThreads, MaxAttempt, NumOperators;
+
+	NumThreads = 1;
+	for (MaxAttempt = 0; AttemptOperators(MaxAttempt + 1, &NumOperators) != nullptr; MaxAttempt++)
+		;
+	for (arg = 1; arg < argc; arg++)
+	{
+		if (strcmp(argv[arg], "--threads") == 0 && arg + 1 < argc && atoi(argv[arg + 1]) >= 1)
+		{
+			NumThreads = atoi(argv[++arg]);
+		}
+		else if (strcmp(argv[arg], "--max-attempt") == 0 && arg + 1 < argc && atoi(argv[arg + 1]) >= 0 && atoi(argv[arg + 1]) <= MaxAttempt)
+		{
+			MaxAttempt = atoi(argv[++arg]);
+		}
+		else
+		{
+			ShowUsage();
+			return 2;
+		}
+	}
+
+	memset(&Totals, 0, sizeof(Totals));
+	InitSolver(&Solver, DEPTH_FIRST_ENGINE, NumThreads);
+	for (s = 0; s < NUM_SAMPLES; s++)
+		BenchAttempts(&Solver, "sample", Samples[s].Seq, Samples[s].SeqLen, MaxAttempt, &Totals);
+	for (s = 0; s < NUM_CORPUS; s++)
+	{
+		for (l = 0; l < NUM_BENCH_LENGTHS && BenchLengths[l] <= Corpus[s].SeqLen; l++)
+			BenchAttempts(&Solver, Corpus[s].Kind, Corpus[s].Seq, BenchLengths[l], MaxAttempt, &Totals);
+	}
+
+	cout << "{\"summary\":{\"cases\":" << Totals.NumCases << ",\"solved\":" << Totals.NumSolved << ",\"threads\":" << NumThreads
+		 << ",\"lanes\":" << NUM_LANES << ",\"ms\":" << fixed << setprecision(3) << Totals.Ms << ",\"candidates\":" << Totals.Candidates
+		 << ",\"candidates_per_sec\":" << setprecision(0) << (Totals.Ms > 0 ? Totals.Candidates * 1000.0 / Totals.Ms : 0.0)
+		 << ",\"peak_kb\":" << PeakMemoryKB() << "}";
+	// Everything SearchStats.h counted, if it was built to.
+	if (SearchStatsEnabled())
+	{
+		cout << ",\"stats\":";
+		WriteSearchStatsJson(cout);
+	}
+	cout << "}" << endl;
+	return 0;
+}
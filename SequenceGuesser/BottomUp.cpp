@@ -0,0 +1,163 @@
+#include "stdafx.h"
+#include <assert.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+#include "BottomUp.h"
+using namespace std;
+
+#define FIRST_NUM_SLOTS	1024
+
+void InitExpressionTable(sExpressionTable *pTable, int SeqLen, size_t MaxBytes)
+{
+	pTable->SeqLen = SeqLen;
+	pTable->RowLen = LANES_ROUND_UP(SeqLen + 1);
+	// Each expression takes its values, itself, and two slots since we keep the hash table no more than half full.
+	pTable->MaxExpressions = MaxBytes / (pTable->RowLen * sizeof(double) + sizeof(sExpression) + 2 * sizeof(int));
+	pTable->Slots.assign(FIRST_NUM_SLOTS, -1);
+	pTable->Full = false;
+}
+
+int LeafValues(const sItem *pItem, const sSearchLimits *pLimits, double Row[])
+{
+	int Pos;
+
+	for (Pos = 0; Pos < LANES_ROUND_UP(pLimits->SeqLen + 1); Pos++)
+	{
+		switch (pItem->ItemType)
+		{
+		case CONSTANT:
+			Row[Pos] = pItem->Index + 1;
+			break;
+		case I:
+			Row[Pos] = pLimits->Positions[Pos];
+			break;
+		case S:
+			Row[Pos] = pLimits->SeqLanes[NUM_POSITIONS + Pos - pItem->Index - 1];
+			break;
+		default:
+			assert(false);
+		}
+	}
+	return pItem->ItemType == S ? pItem->Index + 1 : 0;
+}
+
+bool AggregateValues(bool Product, const sItem *pLeaf, int FirstPos, const sSearchLimits *pLimits, double Row[])
+{
+	tLanes Value;
+	unsigned int Finite, Live;
+	int Pos;
+
+	for (Pos = 0; Pos < LANES_ROUND_UP(pLimits->SeqLen + 1); Pos += NUM_LANES)
+	{
+		Value = AggregateLanesAt(Product, pLeaf, Pos, pLimits);
+		LanesStore(&Row[Pos], Value);
+		if ((Finite = LanesFinite(Value)) != ALL_LANES)
+		{
+			Live = LanesBetween(Pos, max(FirstPos, pLimits->NumIndexValsForItem[S]), pLimits->SeqLen + 1);
+			if ((Finite & Live) != Live)
+				return false;
+		}
+	}
+	return true;
+}
+
+static unsigned long long HashRow(const double Row[], int RowLen, int FirstPos)
+{
+	unsigned long long Hash = FirstPos, Bits;
+	int Pos;
+
+	for (Pos = FirstPos; Pos < RowLen; Pos++)
+	{
+		memcpy(&Bits, &Row[Pos], sizeof(Bits));
+		Hash = (Hash ^ Bits) * 0x9E3779B97F4A7C15ull;
+		Hash ^= Hash >> 29;
+	}
+	return Hash;
+}
+
+// The slot which holds the expression with these values, or the empty slot where it would go.
+static int FindSlot(const sExpressionTable *pTable, const double Row[], int FirstPos)
+{
+	int Mask = (int)pTable->Slots.size() - 1;
+	int Slot, e;
+
+	for (Slot = (int)(HashRow(Row, pTable->RowLen, FirstPos) & Mask); (e = pTable->Slots[Slot]) >= 0; Slot = (Slot + 1) & Mask)
+	{
+		if (pTable->Expressions[e].FirstPos == FirstPos
+		 && memcmp(&pTable->Values[(size_t)e * pTable->RowLen], Row, pTable->RowLen * sizeof(double)) == 0)
+		{
+			break;
+		}
+	}
+	return Slot;
+}
+
+static void GrowSlots(sExpressionTable *pTable)
+{
+	int e;
+
+	pTable->Slots.assign(pTable->Slots.size() * 2, -1);
+	for (e = 0; e < (int)pTable->Expressions.size(); e++)
+		pTable->Slots[FindSlot(pTable, &pTable->Values[(size_t)e * pTable->RowLen], pTable->Expressions[e].FirstPos)] = e;
+}
+
+static bool FitsSequence(const double Row[], int FirstPos, const sSearchLimits *pLimits)
+{
+	unsigned int Wanted;
+	int Pos;
+
+	for (Pos = FirstPos / NUM_LANES * NUM_LANES; Pos < pLimits->SeqLen; Pos += NUM_LANES)
+	{
+		Wanted = LanesBetween(Pos, FirstPos, pLimits->SeqLen);
+		if ((LanesEqual(LanesLoad(&Row[Pos]), LanesLoad(&pLimits->SeqLanes[NUM_POSITIONS + Pos])) & Wanted) != Wanted)
+			return false;
+	}
+	return true;
+}
+
+bool ConsiderExpression(sExpressionTable *pTable, const sExpression *pExpr, double Row[], bool Store, const sSearchLimits *pLimits)
+{
+	int Slot, Pos;
+
+	if (Store)
+	{
+		// Whatever's in the seed positions and the padding after the next number is never looked at, so it mustn't stop
+		// two expressions which give the same values from looking the same.
+		for (Pos = 0; Pos < pExpr->FirstPos; Pos++)
+			Row[Pos] = 0;
+		for (Pos = pTable->SeqLen + 1; Pos < pTable->RowLen; Pos++)
+			Row[Pos] = 0;
+		Slot = FindSlot(pTable, Row, pExpr->FirstPos);
+		if (pTable->Slots[Slot] >= 0)
+			return false;
+		if (pTable->Expressions.size() < pTable->MaxExpressions)
+		{
+			pTable->Slots[Slot] = (int)pTable->Expressions.size();
+			pTable->Expressions.push_back(*pExpr);
+			pTable->Values.insert(pTable->Values.end(), Row, Row + pTable->RowLen);
+			if (pTable->Expressions.size() * 2 > pTable->Slots.size())
+				GrowSlots(pTable);
+		}
+		else
+		{
+			pTable->Full = true;
+		}
+	}
+	return FormulaIsNew(pExpr->Novelty, pExpr->NumItems, pLimits) && FitsSequence(Row, pExpr->FirstPos, pLimits);
+}
+
+static void AppendItems(const sExpressionTable *pTable, const sExpression *pExpr, sFormula *pFormula)
+{
+	if (pExpr->Left >= 0)
+		AppendItems(pTable, &pTable->Expressions[pExpr->Left], pFormula);
+	if (pExpr->Right >= 0)
+		AppendItems(pTable, &pTable->Expressions[pExpr->Right], pFormula);
+	pFormula->Items[pFormula->NumItems++] = pExpr->Item;
+}
+
+void ExpressionToFormula(const sExpressionTable *pTable, const sExpression *pExpr, sFormula *pFormula)
+{
+	pFormula->NumItems = 0;
+	AppendItems(pTable, pExpr, pFormula);
+}
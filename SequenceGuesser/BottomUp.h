@@ -0,0 +1,265 @@
+#pragma once
+
+#include <algorithm>
+#include <vector>
+#include "Lanes.h"
+#include "Operators.h"
+#include "SearchLimits.h"
+#include "Solver.h"
+
+// The other way of searching. Rather than walking through every formula in turn, we build up every expression of 1 item,
+// then every expression of 2 items made from those, then 3 and so on, checking each one as we go. The point is that we only
+// keep one expression for each different set of values it gives over the sequence, so "1 2 +", "2 1 +", "3", "i i - 3 +"
+// and any others which always give the same numbers are only ever built on once, whichever of the rules in
+// CheckOperatorValidHere() they would or wouldn't have been caught by.
+// The catch is that it needs memory for every expression it keeps, so that's bounded, and if it fills up we finish the
+// search with what we've kept and say so.
+
+// How much memory one bottom-up search may use for the expressions it keeps. The vectors holding them can briefly take up
+// to twice this while they grow.
+#define BOTTOM_UP_MAX_BYTES	((size_t)256 << 20)
+
+typedef enum {
+	BOTTOM_UP_FOUND,
+	BOTTOM_UP_NOT_FOUND,	// There's no formula of up to MaxItemsInExpression items.
+	BOTTOM_UP_INCOMPLETE,	// Ran out of memory and didn't find one, so there might still be one we couldn't build.
+	BOTTOM_UP_STOPPED		// SearchStopped() said to give up before we'd finished.
+} eBottomUpResult;
+
+// An expression the bottom-up search has kept. Its values are kept separately in sExpressionTable::Values.
+typedef struct {
+	sItem	Item;		// The leaf (CONSTANT, S or I) or the OPERATOR which combines Left and Right.
+	int		Left;		// The expression below the top of the stack when the operator is applied. -1 for leaves and unary operators.
+	int		Right;		// The expression on top of the stack when the operator is applied. -1 for leaves.
+	int		NumItems;
+	int		FirstPos;	// Positions before this are seeds since the expression refers back before the start of the sequence.
+	unsigned int	Novelty;	// What its items bring in between them which makes a formula new (see sSearchLimits).
+} sExpression;
+
+// Every expression we've kept, in order of size, and a hash table for finding the one which gives a set of values.
+typedef struct {
+	std::vector<sExpression>	Expressions;
+	std::vector<double>			Values;		// Expression e's values at positions 0..RowLen-1 are at Values[e * RowLen].
+	std::vector<int>			Slots;		// Open addressing. Each slot holds an expression number or -1. Size is a power of 2.
+	int							RowLen;		// Positions 0..SeqLen, rounded up to a whole number of lanes.
+	int							SeqLen;
+	size_t						MaxExpressions;
+	bool						Full;		// We've had to throw away an expression because there was no room for it.
+} sExpressionTable;
+
+void InitExpressionTable(sExpressionTable *pTable, int SeqLen, size_t MaxBytes);
+
+// Works out the values of a leaf at every position into Row[]. Returns its FirstPos.
+int LeafValues(const sItem *pItem, const sSearchLimits *pLimits, double Row[]);
+
+// Works out the values of "Leaf sum" (or "Leaf prod" if Product) at every position into Row[], where Leaf is an S(i-k) or i
+// whose FirstPos is FirstPos. Returns false if they're nonsense (overflow) at a position which can never be a seed.
+bool AggregateValues(bool Product, const sItem *pLeaf, int FirstPos, const sSearchLimits *pLimits, double Row[]);
+
+// Looks at a new expression whose values are in Row[]. If we've already got an expression which gives the same values,
+// it's no use to us. Otherwise, if Store, it gets kept (if there's room). Returns true if it fits the sequence, which it
+// can only do if it's new, since otherwise an earlier search would have found it.
+// Row[] gets tidied up on the way, so it only holds the values we care about.
+bool ConsiderExpression(sExpressionTable *pTable, const sExpression *pExpr, double Row[], bool Store, const sSearchLimits *pLimits);
+
+// Writes out the expression in reverse polish as a formula. Its operators and next number aren't filled in.
+void ExpressionToFormula(const sExpressionTable *pTable, const sExpression *pExpr, sFormula *pFormula);
+
+// The values of expression e, which we've kept, at positions 0..RowLen-1.
+static inline const double *ExpressionValues(const sExpressionTable *pTable, int e)
+{
+	return &pTable->Values[(size_t)e * pTable->RowLen];
+}
+
+// Works out the values of operator Op at every position into Row[], given its operands' values. pLeft is nullptr for unary
+// operators. Returns false if it gives nonsense (division by zero, overflow etc.) at a position which can never be a seed,
+// since then nothing built on it can fit, which is the same rule the depth first search uses.
+template <class tOps>
+static inline bool OperatorValues(int Op, int FirstPos, const double *pLeft, const double *pRight, const sSearchLimits *pLimits, double Row[])
+{
+	tLanes Value;
+	unsigned int Finite, Live;
+	int Pos;
+
+	for (Pos = FirstPos / NUM_LANES * NUM_LANES; Pos <= pLimits->SeqLen; Pos += NUM_LANES)
+	{
+		Value = tOps::Apply(Op, pLeft != nullptr ? LanesLoadUnaligned(pLeft + Pos) : LanesSet(0), LanesLoadUnaligned(pRight + Pos));
+		LanesStore(&Row[Pos], Value);
+		if ((Finite = LanesFinite(Value)) != ALL_LANES)
+		{
+			Live = LanesBetween(Pos, std::max(FirstPos, pLimits->NumIndexValsForItem[S]), pLimits->SeqLen + 1);
+			if ((Finite & Live) != Live)
+				return false;
+		}
+	}
+	return true;
+}
+
+// Looks at a new operator expression, whose values are in Row[], and returns true, with the formula in *pFound, if it fits,
+// which as in the depth first search means exactly, not just with doubles.
+// If TryUnary, it's one item short of the longest we're allowed and too big to keep, so we apply the unary operators to it
+// here too, since nothing else will. That saves keeping the biggest level of expressions, which is most of them.
+template <class tOps>
+static bool TryExpression(sExpressionTable *pTable, const sExpression *pExpr, double Row[], bool Store, bool TryUnary, const sSearchLimits *pLimits, sFormula *pFound)
+{
+	alignas(LANES_ALIGNMENT) double UnaryRow[NUM_POSITIONS];
+	sExpression Unary;
+
+	pFound->Operators = tOps::Operators;
+	if (ConsiderExpression(pTable, pExpr, Row, Store, pLimits))
+	{
+		ExpressionToFormula(pTable, pExpr, pFound);
+		if (FormulaGeneratesSequence(pFound, pLimits->pSeq, pLimits->SeqLen))
+			return true;
+	}
+	if (tOps::HasUnary && TryUnary)
+	{
+		Unary = *pExpr;
+		Unary.Item.ItemType = OPERATOR;
+		Unary.Left = Unary.Right = -1;	// Not kept, so we can't refer to it. *pExpr is its operand.
+		Unary.NumItems++;
+		for (Unary.Item.Index = 0; Unary.Item.Index < tOps::NumOperators; Unary.Item.Index++)
+		{
+			Unary.Novelty = pExpr->Novelty | ItemNovelty(&Unary.Item, pLimits);
+			// The aggregates are only built on leaves, which are always kept.
+			if (tOps::NumOperandsOf[Unary.Item.Index] == 1 && !OperatorAlgebra[tOps::KindOf[Unary.Item.Index]].Aggregate
+			 && OperatorValues<tOps>(Unary.Item.Index, pExpr->FirstPos, nullptr, Row, pLimits, UnaryRow)
+			 && ConsiderExpression(pTable, &Unary, UnaryRow, false, pLimits))
+			{
+				ExpressionToFormula(pTable, pExpr, pFound);
+				pFound->Items[pFound->NumItems++] = Unary.Item;
+				if (FormulaGeneratesSequence(pFound, pLimits->pSeq, pLimits->SeqLen))
+					return true;
+			}
+		}
+	}
+	return false;
+}
+
+// Whether an expression which isn't going to be kept is worth working out, i.e. whether it or (if TryUnary) a unary
+// operator applied to it could be new.
+static inline bool WorthTrying(const sExpression *pExpr, bool TryUnary, const sSearchLimits *pLimits)
+{
+	return FormulaIsNew(pExpr->Novelty, pExpr->NumItems, pLimits)
+		|| (TryUnary && FormulaIsNew(pExpr->Novelty | NOVEL_OPERATOR, pExpr->NumItems + 1, pLimits));
+}
+
+// Builds up every expression of up to MaxItems items into *pTable, smallest first, checking each one as it goes, and keeps
+// the ones of up to MaxStoredItems items. The expressions of n items end up at FirstOfSize[n]..FirstOfSize[n+1]-1.
+// Returns BOTTOM_UP_FOUND with the formula in *pFound if one fits, BOTTOM_UP_STOPPED if SearchStopped() said to give up, or
+// BOTTOM_UP_NOT_FOUND otherwise (even if the table filled up, which pTable->Full says).
+template <class tOps>
+static eBottomUpResult BuildExpressions(sExpressionTable *pTable, int FirstOfSize[], int MaxItems, int MaxStoredItems, const sSearchLimits *pLimits, sFormula *pFound)
+{
+	sExpression Expr;
+	alignas(LANES_ALIGNMENT) double Row[NUM_POSITIONS];
+	int NumItems, LeftItems, RightItems, Op, l, r;
+	bool Store, TryUnary, Commutes, Aggregate;
+
+	// The leaves, in the same order as the depth first search tries them. Like it, we always try the first index of each
+	// type, so there's an i even though it has no index values, and an S(i-1) even when MaxRetroS is 0.
+	FirstOfSize[1] = 0;
+	Expr.NumItems = 1;
+	Expr.Left = Expr.Right = -1;
+	for (Expr.Item.ItemType = CONSTANT; Expr.Item.ItemType != OPERATOR; Expr.Item.ItemType = static_cast<eItemType>(Expr.Item.ItemType + 1))
+	{
+		for (Expr.Item.Index = 0; Expr.Item.Index == 0 || Expr.Item.Index < pLimits->NumIndexValsForItem[Expr.Item.ItemType]; Expr.Item.Index++)
+		{
+			Expr.FirstPos = LeafValues(&Expr.Item, pLimits, Row);
+			Expr.Novelty = ItemNovelty(&Expr.Item, pLimits);
+			if (TryExpression<tOps>(pTable, &Expr, Row, MaxStoredItems >= 1, MaxItems == 2 && MaxStoredItems < 1, pLimits, pFound))
+				return BOTTOM_UP_FOUND;
+		}
+	}
+	FirstOfSize[2] = (int)pTable->Expressions.size();
+
+	Expr.Item.ItemType = OPERATOR;
+	for (NumItems = 2; NumItems <= MaxItems; NumItems++)
+	{
+		// Each size takes a lot longer than the one before, so this says less than it seems to.
+		if (pLimits->pWatch != nullptr)
+		{
+			pLimits->pWatch->UnitsDone = NumItems - 2;
+			pLimits->pWatch->NumUnits = MaxItems - 1;
+		}
+		Expr.NumItems = NumItems;
+		Store = NumItems <= MaxStoredItems;
+		TryUnary = NumItems == MaxItems - 1 && !Store;
+		for (Op = 0; Op < tOps::NumOperators; Op++)
+		{
+			Expr.Item.Index = Op;
+			if (SearchStopped(pLimits->pWatch))
+				return BOTTOM_UP_STOPPED;
+			if (tOps::HasUnary && tOps::NumOperandsOf[Op] == 1)
+			{
+				// An aggregate only goes on an S(i-k) or i, like in the depth first search.
+				Aggregate = tOps::HasAggregate && OperatorAlgebra[tOps::KindOf[Op]].Aggregate;
+				if (Aggregate && NumItems != 2)
+					continue;
+				Expr.Left = -1;
+				for (r = FirstOfSize[NumItems - 1]; r < FirstOfSize[NumItems]; r++)
+				{
+					if (Aggregate && pTable->Expressions[r].Item.ItemType == CONSTANT)
+						continue;
+					Expr.Right = r;
+					Expr.FirstPos = pTable->Expressions[r].FirstPos;
+					Expr.Novelty = pTable->Expressions[r].Novelty | ItemNovelty(&Expr.Item, pLimits);
+					if ((Store || WorthTrying(&Expr, TryUnary, pLimits))
+					 && (Aggregate ? AggregateValues(tOps::Is(Op, PRODUCT_OP), &pTable->Expressions[r].Item, Expr.FirstPos, pLimits, Row)
+								   : OperatorValues<tOps>(Op, Expr.FirstPos, nullptr, ExpressionValues(pTable, r), pLimits, Row))
+					 && TryExpression<tOps>(pTable, &Expr, Row, Store, TryUnary, pLimits, pFound))
+					{
+						return BOTTOM_UP_FOUND;
+					}
+				}
+				continue;
+			}
+			// a+b and b+a give the same values so only build one of them.
+			Commutes = OperatorAlgebra[tOps::KindOf[Op]].Commutative;
+			for (LeftItems = 1; LeftItems < NumItems - 1; LeftItems++)
+			{
+				RightItems = NumItems - 1 - LeftItems;
+				if (Commutes && LeftItems > RightItems)
+					break;
+				for (l = FirstOfSize[LeftItems]; l < FirstOfSize[LeftItems + 1]; l++)
+				{
+					if (SearchStopped(pLimits->pWatch))
+						return BOTTOM_UP_STOPPED;
+					Expr.Left = l;
+					for (r = Commutes && LeftItems == RightItems ? l : FirstOfSize[RightItems]; r < FirstOfSize[RightItems + 1]; r++)
+					{
+						Expr.Right = r;
+						Expr.FirstPos = std::max(pTable->Expressions[l].FirstPos, pTable->Expressions[r].FirstPos);
+						Expr.Novelty = pTable->Expressions[l].Novelty | pTable->Expressions[r].Novelty | ItemNovelty(&Expr.Item, pLimits);
+						if ((Store || WorthTrying(&Expr, TryUnary, pLimits))
+						 && OperatorValues<tOps>(Op, Expr.FirstPos, ExpressionValues(pTable, l), ExpressionValues(pTable, r), pLimits, Row)
+						 && TryExpression<tOps>(pTable, &Expr, Row, Store, TryUnary, pLimits, pFound))
+						{
+							return BOTTOM_UP_FOUND;
+						}
+					}
+				}
+			}
+		}
+		FirstOfSize[NumItems + 1] = (int)pTable->Expressions.size();
+	}
+	return BOTTOM_UP_NOT_FOUND;
+}
+
+// Searches for a formula which fits the sequence, using the operators in tOps and up to pLimits->MaxItemsInExpression
+// items, by building up expressions smallest first. So if there is one, it finds one of the shortest, which isn't
+// necessarily the one the depth first search would have found first.
+template <class tOps>
+static eBottomUpResult BottomUpSearch(const sSearchLimits *pLimits, size_t MaxBytes, sFormula *pFound)
+{
+	sExpressionTable Table;
+	int FirstOfSize[MAX_POSS_ITEMS_IN_EXPRESSION + 2];
+	eBottomUpResult Result;
+
+	InitExpressionTable(&Table, pLimits->SeqLen, MaxBytes);
+	// Every expression gets checked, but there's no point keeping ones too big to build anything else on.
+	Result = BuildExpressions<tOps>(&Table, FirstOfSize, pLimits->MaxItemsInExpression, pLimits->MaxItemsInExpression - 2, pLimits, pFound);
+	if (Result == BOTTOM_UP_NOT_FOUND && Table.Full)
+		Result = BOTTOM_UP_INCOMPLETE;
+	return Result;
+}
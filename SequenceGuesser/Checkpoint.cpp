@@ -0,0 +1,180 @@
+#include "stdafx.h"
+#include <stdint.h>
+#include <string.h>
+#ifdef _WIN32
+#include <windows.h>
+#endif
+#include <fstream>
+#include <string>
+#include <vector>
+#include "Checkpoint.h"
+#include "Solver.h"
+using namespace std;
+
+#define CHECKPOINT_MAGIC	0x43434753	// "SGCC" when you look at the file.
+#define CHECKPOINT_VERSION	1
+
+// A formula, with each item as its type and index.
+typedef struct {
+	int32_t		NumItems;
+	uint8_t		Items[MAX_POSS_ITEMS_IN_EXPRESSION][2];
+} sCheckpointFormula;
+
+// The file is this, then a status byte for each task, then an sCheckpointTask for each one which is TASK_STARTED.
+typedef struct {
+	uint32_t	Magic;
+	uint32_t	Version;
+	uint64_t	Fingerprint;	// AttemptsFingerprint(), since the tasks are different for different attempts.
+	int32_t		SeqLen;
+	int32_t		Seq[MAX_SEQ_LEN];
+	int32_t		Shard;
+	int32_t		NumShards;
+	int32_t		MaxRetroS;
+	int32_t		Attempt;
+	int32_t		FoundTask;
+	sCheckpointFormula	Found;
+	int64_t		FoundNextNum;
+	int32_t		NumTasks;
+} sCheckpointHeader;
+
+typedef struct {
+	sCheckpointFormula	Formula;
+	int32_t		StackHeight;
+	int32_t		ItemValid;
+} sCheckpointTask;
+
+static void PackFormula(const sItem Items[], int NumItems, sCheckpointFormula *pPacked)
+{
+	int inum;
+
+	memset(pPacked, 0, sizeof(*pPacked));
+	pPacked->NumItems = NumItems;
+	for (inum = 0; inum < NumItems; inum++)
+	{
+		pPacked->Items[inum][0] = (uint8_t)Items[inum].ItemType;
+		pPacked->Items[inum][1] = (uint8_t)Items[inum].Index;
+	}
+}
+
+// Returns false if the formula can't be one of attempt Attempt's.
+static bool UnpackFormula(const sCheckpointFormula *pPacked, int Attempt, sItem Items[], int *pNumItems)
+{
+	int inum, NumOperators;
+
+	if (AttemptOperators(Attempt, &NumOperators) == nullptr || pPacked->NumItems < 1 || pPacked->NumItems > MAX_POSS_ITEMS_IN_EXPRESSION)
+		return false;
+	for (inum = 0; inum < pPacked->NumItems; inum++)
+	{
+		if (pPacked->Items[inum][0] >= NUM_ITEM_TYPES || (pPacked->Items[inum][0] == OPERATOR && pPacked->Items[inum][1] >= NumOperators))
+			return false;
+		Items[inum].ItemType = (eItemType)pPacked->Items[inum][0];
+		Items[inum].Index = pPacked->Items[inum][1];
+	}
+	*pNumItems = pPacked->NumItems;
+	return true;
+}
+
+bool SaveCheckpoint(const char *FileName, const int Seq[], int SeqLen, const sSolver *pSolver, const sSearchCheckpoint *pCheckpoint)
+{
+	string TempName = string(FileName) + ".tmp";
+	sCheckpointHeader Header;
+	sCheckpointTask Task;
+	vector<uint8_t> Statuses(pCheckpoint->Tasks.size());
+	size_t t;
+
+	memset(&Header, 0, sizeof(Header));
+	Header.Magic = CHECKPOINT_MAGIC;
+	Header.Version = CHECKPOINT_VERSION;
+	Header.Fingerprint = AttemptsFingerprint();
+	Header.SeqLen = SeqLen;
+	memcpy(Header.Seq, Seq, SeqLen * sizeof(Seq[0]));
+	Header.Shard = pSolver->Shard;
+	Header.NumShards = pSolver->NumShards;
+	Header.MaxRetroS = pCheckpoint->MaxRetroS;
+	Header.Attempt = pCheckpoint->Attempt;
+	Header.FoundTask = pCheckpoint->FoundTask;
+	if (pCheckpoint->FoundTask >= 0)
+	{
+		PackFormula(pCheckpoint->Found.Items, pCheckpoint->Found.NumItems, &Header.Found);
+		Header.FoundNextNum = pCheckpoint->Found.NextNum;
+	}
+	Header.NumTasks = (int32_t)pCheckpoint->Tasks.size();
+	for (t = 0; t < Statuses.size(); t++)
+		Statuses[t] = (uint8_t)pCheckpoint->Tasks[t].Status;
+
+	{
+		ofstream Out(TempName, ios::binary | ios::trunc);
+
+		Out.write((const char *)&Header, sizeof(Header));
+		if (!Statuses.empty())
+			Out.write((const char *)&Statuses[0], Statuses.size());
+		for (const sTaskCheckpoint& Started : pCheckpoint->Tasks)
+		{
+			if (Started.Status != TASK_STARTED)
+				continue;
+			PackFormula(Started.Items, Started.NumItems, &Task.Formula);
+			Task.StackHeight = Started.StackHeight;
+			Task.ItemValid = Started.ItemValid;
+			Out.write((const char *)&Task, sizeof(Task));
+		}
+		Out.flush();
+		if (!Out.good())
+			return false;
+	}
+#ifdef _WIN32
+	return MoveFileExA(TempName.c_str(), FileName, MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+	return rename(TempName.c_str(), FileName) == 0;
+#endif
+}
+
+bool LoadCheckpoint(const char *FileName, const int Seq[], int SeqLen, const sSolver *pSolver, sSearchCheckpoint *pCheckpoint)
+{
+	ifstream In(FileName, ios::binary);
+	sCheckpointHeader Header;
+	sCheckpointTask Task;
+	vector<uint8_t> Statuses;
+	int NumOperators;
+	size_t t;
+
+	if (!In.read((char *)&Header, sizeof(Header))
+	 || Header.Magic != CHECKPOINT_MAGIC
+	 || Header.Version != CHECKPOINT_VERSION
+	 || Header.Fingerprint != AttemptsFingerprint()
+	 || Header.SeqLen != SeqLen || memcmp(Header.Seq, Seq, SeqLen * sizeof(Seq[0])) != 0
+	 || Header.Shard != pSolver->Shard || Header.NumShards != pSolver->NumShards
+	 || Header.MaxRetroS < 0 || AttemptOperators(Header.Attempt, &NumOperators) == nullptr
+	 || Header.NumTasks < 0 || Header.FoundTask < -1 || Header.FoundTask >= Header.NumTasks)
+	{
+		return false;
+	}
+	pCheckpoint->MaxRetroS = Header.MaxRetroS;
+	pCheckpoint->Attempt = Header.Attempt;
+	pCheckpoint->FoundTask = Header.FoundTask;
+	if (Header.FoundTask >= 0)
+	{
+		if (!UnpackFormula(&Header.Found, Header.Attempt, pCheckpoint->Found.Items, &pCheckpoint->Found.NumItems))
+			return false;
+		pCheckpoint->Found.Operators = AttemptOperators(Header.Attempt, &NumOperators);
+		pCheckpoint->Found.NextNum = Header.FoundNextNum;
+	}
+	Statuses.resize(Header.NumTasks);
+	if (!Statuses.empty() && !In.read((char *)&Statuses[0], Statuses.size()))
+		return false;
+	pCheckpoint->Tasks.resize(Header.NumTasks);
+	for (t = 0; t < Statuses.size(); t++)
+	{
+		sTaskCheckpoint& Loaded = pCheckpoint->Tasks[t];
+
+		if (Statuses[t] != TASK_NOT_STARTED && Statuses[t] != TASK_STARTED && Statuses[t] != TASK_DONE)
+			return false;
+		Loaded.Status = (eTaskStatus)Statuses[t];
+		if (Loaded.Status != TASK_STARTED)
+			continue;
+		if (!In.read((char *)&Task, sizeof(Task)) || !UnpackFormula(&Task.Formula, Header.Attempt, Loaded.Items, &Loaded.NumItems))
+			return false;
+		Loaded.StackHeight = Task.StackHeight;
+		Loaded.ItemValid = Task.ItemValid != 0;
+	}
+	return true;
+}
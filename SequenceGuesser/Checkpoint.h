@@ -0,0 +1,15 @@
+#pragma once
+
+#include "Solver.h"
+
+// Checkpoint files, so that a solve which takes hours can carry on from where it was stopped, or the process was killed,
+// rather than from the start. A file holds an sSearchCheckpoint, along with the sequence, the shard and the attempts it's
+// for, since it's no use for anything else. Each of the depth first search's tasks takes a byte, apart from the ones which
+// were part way through, which also have their formula, so a file is a few KB.
+
+// Writes the checkpoint to FileName. It goes in a new file which is then renamed over the old one, so being killed part way
+// through leaves the last checkpoint as it was.
+bool SaveCheckpoint(const char *FileName, const int Seq[], int SeqLen, const sSolver *pSolver, const sSearchCheckpoint *pCheckpoint);
+
+// Reads the checkpoint in FileName. Returns false if it can't, or it's for a different sequence, shard or attempts.
+bool LoadCheckpoint(const char *FileName, const int Seq[], int SeqLen, const sSolver *pSolver, sSearchCheckpoint *pCheckpoint);
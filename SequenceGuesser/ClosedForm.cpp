@@ -0,0 +1,461 @@
+#include "stdafx.h"
+#include <string.h>
+#include "ClosedForm.h"
+#include "Operators.h"
+#include "Solver.h"
+using namespace std;
+
+#define MAX_UNKNOWNS	(MAX_SEQ_LEN / 2 + 1)	// A recurrence's coefficients and its constant, which need twice as many numbers.
+
+// A fraction in lowest terms, with Den > 0.
+typedef struct {
+	tExactInt	Num, Den;
+} sFraction;
+
+static tExactInt Gcd(tExactInt a, tExactInt b)
+{
+	tExactInt t;
+
+	a = a < 0 ? -a : a;
+	b = b < 0 ? -b : b;
+	while (b != 0)
+	{
+		t = a % b;
+		a = b;
+		b = t;
+	}
+	return a;
+}
+
+static bool MakeFraction(tExactInt Num, tExactInt Den, sFraction *pResult)
+{
+	tExactInt Divisor;
+
+	if (Den == 0)
+		return false;
+	if (Den < 0 && (!SubtractExactly(0, Num, &Num) || !SubtractExactly(0, Den, &Den)))
+		return false;
+	Divisor = Num == 0 ? Den : Gcd(Num, Den);
+	pResult->Num = Num / Divisor;
+	pResult->Den = Den / Divisor;
+	return true;
+}
+
+// *pResult = a - b * c, which is all the elimination needs.
+static bool SubtractProduct(const sFraction *pA, const sFraction *pB, const sFraction *pC, sFraction *pResult)
+{
+	tExactInt ProductNum, ProductDen, Left, Right, Den;
+
+	if (!MultiplyExactly(pB->Num, pC->Num, &ProductNum) || !MultiplyExactly(pB->Den, pC->Den, &ProductDen))
+		return false;
+	return MultiplyExactly(pA->Num, ProductDen, &Left) && MultiplyExactly(ProductNum, pA->Den, &Right)
+		&& MultiplyExactly(pA->Den, ProductDen, &Den) && SubtractExactly(Left, Right, &Left) && MakeFraction(Left, Den, pResult);
+}
+
+static bool Divide(const sFraction *pA, const sFraction *pB, sFraction *pResult)
+{
+	tExactInt Num, Den;
+
+	return MultiplyExactly(pA->Num, pB->Den, &Num) && MultiplyExactly(pA->Den, pB->Num, &Den) && MakeFraction(Num, Den, pResult);
+}
+
+// Tacks an item onto the formula. An OPERATOR's Index is its eOperatorKind until ChooseOperators() sorts it out.
+static bool WriteItem(sFormula *pFormula, eItemType ItemType, int Index)
+{
+	if (pFormula->NumItems == MAX_POSS_ITEMS_IN_EXPRESSION)
+		return false;
+	pFormula->Items[pFormula->NumItems].ItemType = ItemType;
+	pFormula->Items[pFormula->NumItems].Index = Index;
+	pFormula->NumItems++;
+	return true;
+}
+
+// Writes out a whole number of at least 1 as a product of the constants 1 to 9, e.g. 10 is "2 5 *". One with a prime factor
+// over 9, e.g. 11 or 37, can't be: it would have to be a sum like "9 2 +", which the search only counts as a constant (see
+// PRUNE_CONSTANTS), so the formula would never be one it could find. The same goes for "2 5 *" on its own, but not once it
+// multiplies something, since NormaliseFormula() makes "2 5 * i *" into "2 5 i * *".
+static bool WriteNumber(sFormula *pFormula, tExactInt n)
+{
+	int Factor;
+
+	if (n < 1)
+		return false;
+	if (n <= 9)
+		return WriteItem(pFormula, CONSTANT, (int)n - 1);
+	for (Factor = 9; Factor >= 2; Factor--)
+	{
+		if (n % Factor == 0)
+			return WriteNumber(pFormula, n / Factor) && WriteItem(pFormula, CONSTANT, Factor - 1) && WriteItem(pFormula, OPERATOR, MULTIPLY_OP);
+	}
+	return false;
+}
+
+// One term of a sum: Coefficient times Item to the power Power. Power 0 means just Coefficient.
+typedef struct {
+	tExactInt	Coefficient;
+	sItem		Item;
+	int			Power;
+} sTerm;
+
+static bool WriteTerm(sFormula *pFormula, tExactInt Magnitude, const sTerm *pTerm)
+{
+	int n;
+
+	if (pTerm->Power == 0)
+		return WriteNumber(pFormula, Magnitude);
+	if (Magnitude != 1 && !WriteNumber(pFormula, Magnitude))
+		return false;
+	for (n = 0; n < pTerm->Power; n++)
+	{
+		if (!WriteItem(pFormula, pTerm->Item.ItemType, pTerm->Item.Index) || (n > 0 && !WriteItem(pFormula, OPERATOR, MULTIPLY_OP)))
+			return false;
+	}
+	return Magnitude == 1 || WriteItem(pFormula, OPERATOR, MULTIPLY_OP);
+}
+
+// Writes out the sum of the terms, divided by Denominator. The ones with positive coefficients go first, so that there's
+// something to take the rest away from, with a constant before the others, since the search tries constants first. If
+// there aren't any, it's "1 - (the rest) - 1", since there's no 0 to start from.
+static bool WriteSum(sFormula *pFormula, const sTerm Terms[], int NumTerms, tExactInt Denominator)
+{
+	bool AnyPositive = false;
+	int Pass, t;
+
+	pFormula->NumItems = 0;
+	for (Pass = 0; Pass < 2; Pass++)
+	{
+		for (t = 0; t < NumTerms; t++)
+		{
+			if (Terms[t].Coefficient > 0 && (Terms[t].Power == 0) == (Pass == 0))
+			{
+				if (!WriteTerm(pFormula, Terms[t].Coefficient, &Terms[t]) || (AnyPositive && !WriteItem(pFormula, OPERATOR, ADD_OP)))
+					return false;
+				AnyPositive = true;
+			}
+		}
+	}
+	if (!AnyPositive && !WriteItem(pFormula, CONSTANT, 0))
+		return false;
+	for (t = 0; t < NumTerms; t++)
+	{
+		if (Terms[t].Coefficient < 0 && (!WriteTerm(pFormula, -Terms[t].Coefficient, &Terms[t]) || !WriteItem(pFormula, OPERATOR, SUBTRACT_OP)))
+			return false;
+	}
+	if (!AnyPositive && (!WriteItem(pFormula, CONSTANT, 0) || !WriteItem(pFormula, OPERATOR, SUBTRACT_OP)))
+		return false;
+	return Denominator == 1 || (WriteNumber(pFormula, Denominator) && WriteItem(pFormula, OPERATOR, DIVIDE_OP));
+}
+
+// Writes out the polynomial Coefficients[Degree] i^Degree + ... + Coefficients[0], divided by Denominator, by Horner's
+// rule: "a i * b + i * c +" for a i^2 + b i + c. That's shorter than WriteSum() unless most of the coefficients are 0 or the
+// first one is negative, in which case it's "1 - (the rest, the other way up) - 1" like WriteSum().
+static bool WriteHorner(sFormula *pFormula, const tExactInt Coefficients[], int Degree, tExactInt Denominator)
+{
+	tExactInt Sign = Coefficients[Degree] < 0 ? -1 : 1, Coefficient;
+	int m;
+
+	pFormula->NumItems = 0;
+	if (Sign < 0 && !WriteItem(pFormula, CONSTANT, 0))
+		return false;
+	if (Degree == 0 || Sign * Coefficients[Degree] != 1)
+	{
+		if (!WriteNumber(pFormula, Sign * Coefficients[Degree]) || (Degree > 0 && (!WriteItem(pFormula, I, 0) || !WriteItem(pFormula, OPERATOR, MULTIPLY_OP))))
+			return false;
+	}
+	else if (!WriteItem(pFormula, I, 0))
+	{
+		return false;
+	}
+	for (m = Degree - 1; m >= 0; m--)
+	{
+		Coefficient = Sign * Coefficients[m];
+		if (Coefficient != 0 && (!WriteNumber(pFormula, Coefficient < 0 ? -Coefficient : Coefficient) || !WriteItem(pFormula, OPERATOR, Coefficient < 0 ? SUBTRACT_OP : ADD_OP)))
+			return false;
+		if (m > 0 && (!WriteItem(pFormula, I, 0) || !WriteItem(pFormula, OPERATOR, MULTIPLY_OP)))
+			return false;
+	}
+	if (Sign < 0 && (!WriteItem(pFormula, OPERATOR, SUBTRACT_OP) || !WriteItem(pFormula, CONSTANT, 0) || !WriteItem(pFormula, OPERATOR, SUBTRACT_OP)))
+		return false;
+	return Denominator == 1 || (WriteNumber(pFormula, Denominator) && WriteItem(pFormula, OPERATOR, DIVIDE_OP));
+}
+
+// Whether operand A goes after operand B in the order the depth first search puts a commutative operator's operands in.
+static bool OperandAfter(const sItem *pA, const sItem *pB)
+{
+	return pA->ItemType > pB->ItemType || (pA->ItemType == pB->ItemType && pA->Index > pB->Index);
+}
+
+// Rewrites the formula the way the depth first search would have it, where that's just a matter of moving items about:
+// "b a +" becomes "a b +", and "a b + c -" becomes "a b c - +" (see PRUNE_OPERANDS_ORDER and PRUNE_OPERATOR_OPERAND_OPERATOR).
+// An OPERATOR's Index is still its eOperatorKind. The other things the search skips, like "2 5 *", are left as they are.
+static void NormaliseFormula(sFormula *pFormula)
+{
+	sItem *Items = pFormula->Items;
+	eOperatorKind Kind1, Kind2, Group;
+	bool Changed = true;
+	int n, Passes;
+
+	for (Passes = 0; Changed && Passes < MAX_POSS_ITEMS_IN_EXPRESSION * MAX_POSS_ITEMS_IN_EXPRESSION; Passes++)
+	{
+		Changed = false;
+		for (n = 2; n < pFormula->NumItems; n++)
+		{
+			if (Items[n].ItemType != OPERATOR || sOperatorTable::ByKind[Items[n].Index].NumOperands != 2 || Items[n - 1].ItemType == OPERATOR)
+				continue;
+			Kind2 = (eOperatorKind)Items[n].Index;
+			if (Items[n - 2].ItemType != OPERATOR)
+			{
+				if (OperatorAlgebra[Kind2].Commutative && OperandAfter(&Items[n - 2], &Items[n - 1]))
+				{
+					swap(Items[n - 2], Items[n - 1]);
+					Changed = true;
+				}
+				continue;
+			}
+			// "a b op1 c op2" is "a b c op2' op1", where op2' is op2 if op1 is the associative one of the group, e.g. +,
+			// or otherwise the other one, e.g. "a b - c +" is "a b c - -".
+			Kind1 = (eOperatorKind)Items[n - 2].Index;
+			Group = AssociativeGroupOf(Kind1);
+			if (sOperatorTable::ByKind[Kind1].NumOperands == 2 && Group != NUM_OPERATOR_KINDS && Group == AssociativeGroupOf(Kind2))
+			{
+				Items[n - 2] = Items[n - 1];
+				Items[n - 1].ItemType = OPERATOR;
+				Items[n - 1].Index = Kind1 == Group ? Kind2 : OperatorAlgebra[Kind2].Inverse;
+				Items[n].Index = Kind1;
+				Changed = true;
+			}
+		}
+	}
+}
+
+// Puts the formula the way the search would have it, finds the first attempt which has all the operators it uses and room
+// for all its items, and turns the OPERATOR items' kinds into indices into its operators. Returns false if there isn't
+// one, or if the search would still skip the formula for being the same as another one (e.g. "2 5 *", which it counts as
+// just a constant), since then the answer would depend on whether it was solved for or searched for. More operators only
+// ever skip more, so later attempts would too.
+static bool ChooseOperators(sFormula *pFormula, int *pAttempt)
+{
+	const sOperator* const* Operators;
+	int IndexOf[NUM_OPERATOR_KINDS];
+	int Attempt, NumOperators, Kind, inum;
+	bool HasAll;
+
+	NormaliseFormula(pFormula);
+	for (Attempt = 0; (Operators = AttemptOperators(Attempt, &NumOperators)) != nullptr; Attempt++)
+	{
+		for (Kind = 0; Kind < NUM_OPERATOR_KINDS; Kind++)
+			IndexOf[Kind] = -1;
+		for (inum = 0; inum < NumOperators; inum++)
+		{
+			if ((Kind = OperatorKindOf(Operators[inum])) != NUM_OPERATOR_KINDS)
+				IndexOf[Kind] = inum;
+		}
+		for (inum = 0, HasAll = true; inum < pFormula->NumItems; inum++)
+		{
+			if (pFormula->Items[inum].ItemType == OPERATOR && IndexOf[pFormula->Items[inum].Index] < 0)
+				HasAll = false;
+		}
+		if (!HasAll || pFormula->NumItems > AttemptMaxItems(Attempt))
+			continue;
+		for (inum = 0; inum < pFormula->NumItems; inum++)
+		{
+			if (pFormula->Items[inum].ItemType == OPERATOR)
+				pFormula->Items[inum].Index = IndexOf[pFormula->Items[inum].Index];
+		}
+		pFormula->Operators = Operators;
+		*pAttempt = Attempt;
+		return AttemptSearchesFormula(Attempt, pFormula);
+	}
+	return false;
+}
+
+// The polynomial of the lowest degree which generates the sequence, written out by WriteHorner() if Horner, or else by
+// WriteSum(). Its degree has to be at least 2 less than the length of the sequence, so that there's a number to check it
+// against.
+static bool PolynomialFormula(const int Seq[], int SeqLen, bool Horner, sFormula *pFormula)
+{
+	tExactInt Diffs[MAX_SEQ_LEN], Leading[MAX_SEQ_LEN];	// Leading[j] is the jth difference at position 0.
+	tExactInt Falling[MAX_SEQ_LEN + 1], Coefficients[MAX_SEQ_LEN], Factorial, Scale, Divisor, Part;
+	sTerm Terms[MAX_SEQ_LEN];
+	int Degree, n, j, m;
+	bool Constant;
+
+	for (n = 0; n < SeqLen; n++)
+		Diffs[n] = Seq[n];
+	for (Degree = 0; ; Degree++)
+	{
+		Leading[Degree] = Diffs[0];
+		for (n = 1, Constant = true; n < SeqLen - Degree; n++)
+			Constant = Constant && Diffs[n] == Diffs[0];
+		if (Constant)
+			break;
+		if (Degree + 1 > SeqLen - 2)
+			return false;
+		for (n = 0; n < SeqLen - Degree - 1; n++)
+		{
+			if (!SubtractExactly(Diffs[n + 1], Diffs[n], &Diffs[n]))
+				return false;
+		}
+	}
+
+	// S(i) is the sum of Leading[j] * i (i-1) ... (i-j+1) / j!, so multiply it all by Degree! to keep it whole, and
+	// multiply out the falling factorials to get the coefficient of each power of i.
+	for (m = 0; m <= Degree; m++)
+	{
+		Terms[m].Coefficient = 0;
+		Terms[m].Item.ItemType = I;
+		Terms[m].Item.Index = 0;
+		Terms[m].Power = m;
+	}
+	for (Factorial = 1, j = 2; j <= Degree; j++)
+	{
+		if (!MultiplyExactly(Factorial, j, &Factorial))
+			return false;
+	}
+	Falling[0] = 1;
+	for (j = 0, Scale = Factorial; j <= Degree; j++)
+	{
+		// Falling[] is i (i-1) ... (i-j+1), and Scale is Degree! / j!.
+		for (m = 0; m <= j; m++)
+		{
+			if (!MultiplyExactly(Leading[j], Falling[m], &Part) || !MultiplyExactly(Part, Scale, &Part)
+			 || !AddExactly(Terms[m].Coefficient, Part, &Terms[m].Coefficient))
+			{
+				return false;
+			}
+		}
+		Falling[j + 1] = 0;
+		for (m = j + 1; m > 0; m--)
+		{
+			if (!MultiplyExactly(Falling[m], j, &Part) || !SubtractExactly(Falling[m - 1], Part, &Falling[m]))
+				return false;
+		}
+		if (!MultiplyExactly(Falling[0], -j, &Falling[0]))
+			return false;
+		if (j < Degree)
+			Scale /= j + 1;
+	}
+	for (m = 0, Divisor = Factorial; m <= Degree; m++)
+		Divisor = Gcd(Divisor, Terms[m].Coefficient);
+	for (m = 0; m <= Degree; m++)
+	{
+		Terms[m].Coefficient /= Divisor;
+		Coefficients[m] = Terms[m].Coefficient;
+	}
+	// With the biggest power first.
+	if (Horner)
+		return WriteHorner(pFormula, Coefficients, Degree, Factorial / Divisor);
+	for (m = 0; m < (Degree + 1) / 2; m++)
+		swap(Terms[m], Terms[Degree - m]);
+	return WriteSum(pFormula, Terms, Degree + 1, Factorial / Divisor);
+}
+
+// The recurrence S(i) = c1 S(i-1) + ... + cOrder S(i-Order) (+ c0 if Constant) which generates the sequence, if there's
+// exactly one, found by Gaussian elimination on the equations which the sequence gives us.
+static bool RecurrenceFormula(const int Seq[], int SeqLen, int Order, bool Constant, sFormula *pFormula)
+{
+	sFraction Rows[MAX_SEQ_LEN][MAX_UNKNOWNS + 1];	// Each equation's coefficients, then S(i) on the right.
+	sFraction Pivot;
+	sTerm Terms[MAX_UNKNOWNS];
+	tExactInt Denominator;
+	int NumUnknowns = Order + (Constant ? 1 : 0), NumRows = SeqLen - Order;
+	int Row, Col, r, c;
+
+	// There have to be more equations than unknowns for one of them to be a check.
+	if (Order < 1 || NumRows <= NumUnknowns)
+		return false;
+	for (Row = 0; Row < NumRows; Row++)
+	{
+		for (Col = 0; Col < Order; Col++)
+			Rows[Row][Col] = { Seq[Order + Row - Col - 1], 1 };
+		if (Constant)
+			Rows[Row][Order] = { 1, 1 };
+		Rows[Row][NumUnknowns] = { Seq[Order + Row], 1 };
+	}
+	for (Col = 0; Col < NumUnknowns; Col++)
+	{
+		// If there's no pivot, there's more than one solution, so we can't tell which one the next number comes from.
+		for (Row = Col; Row < NumRows && Rows[Row][Col].Num == 0; Row++)
+			;
+		if (Row == NumRows)
+			return false;
+		for (c = 0; c <= NumUnknowns; c++)
+			swap(Rows[Row][c], Rows[Col][c]);
+		Pivot = Rows[Col][Col];
+		for (c = Col; c <= NumUnknowns; c++)
+		{
+			if (!Divide(&Rows[Col][c], &Pivot, &Rows[Col][c]))
+				return false;
+		}
+		for (r = 0; r < NumRows; r++)
+		{
+			if (r == Col || Rows[r][Col].Num == 0)
+				continue;
+			Pivot = Rows[r][Col];
+			for (c = Col; c <= NumUnknowns; c++)
+			{
+				if (!SubtractProduct(&Rows[r][c], &Pivot, &Rows[Col][c], &Rows[r][c]))
+					return false;
+			}
+		}
+	}
+	// The equations which were left over are the checks. If there's no S(i-Order) in it, it's a recurrence of a lower order.
+	for (Row = NumUnknowns; Row < NumRows; Row++)
+	{
+		if (Rows[Row][NumUnknowns].Num != 0)
+			return false;
+	}
+	if (Rows[Order - 1][NumUnknowns].Num == 0)
+		return false;
+
+	for (Col = 0, Denominator = 1; Col < NumUnknowns; Col++)
+	{
+		if (!MultiplyExactly(Denominator / Gcd(Denominator, Rows[Col][NumUnknowns].Den), Rows[Col][NumUnknowns].Den, &Denominator))
+			return false;
+	}
+	for (Col = 0; Col < NumUnknowns; Col++)
+	{
+		if (!MultiplyExactly(Rows[Col][NumUnknowns].Num, Denominator / Rows[Col][NumUnknowns].Den, &Terms[Col].Coefficient))
+			return false;
+		Terms[Col].Item.ItemType = Col < Order ? S : CONSTANT;
+		Terms[Col].Item.Index = Col;
+		Terms[Col].Power = Col < Order ? 1 : 0;
+	}
+	return WriteSum(pFormula, Terms, NumUnknowns, Denominator);
+}
+
+bool SolvePolynomial(const int Seq[], int SeqLen, sFormula *pFound, int *pAttempt)
+{
+	sFormula Horner;
+	int HornerAttempt;
+	bool SumFound, HornerFound;
+
+	// Like the searches, we don't guess from two numbers.
+	if (SeqLen < 3)
+		return false;
+	// Whichever way of writing it out is shorter, out of the ones the search would have. E.g. "i i *" is skipped where
+	// there's a "^2", but Horner's rule doesn't need it.
+	SumFound = PolynomialFormula(Seq, SeqLen, false, pFound) && ChooseOperators(pFound, pAttempt) && FormulaGeneratesSequence(pFound, Seq, SeqLen);
+	HornerFound = PolynomialFormula(Seq, SeqLen, true, &Horner) && ChooseOperators(&Horner, &HornerAttempt) && FormulaGeneratesSequence(&Horner, Seq, SeqLen);
+	if (HornerFound && (!SumFound || Horner.NumItems < pFound->NumItems))
+	{
+		*pFound = Horner;
+		*pAttempt = HornerAttempt;
+	}
+	return SumFound || HornerFound;
+}
+
+bool SolveRecurrence(const int Seq[], int SeqLen, int Order, sFormula *pFound, int *pAttempt)
+{
+	int Constant;
+
+	for (Constant = 0; Constant <= 1; Constant++)
+	{
+		if (RecurrenceFormula(Seq, SeqLen, Order, Constant != 0, pFound) && ChooseOperators(pFound, pAttempt)
+		 && FormulaGeneratesSequence(pFound, Seq, SeqLen))
+		{
+			return true;
+		}
+	}
+	return false;
+}
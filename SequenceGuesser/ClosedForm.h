@@ -0,0 +1,30 @@
+#pragma once
+
+#include "Solver.h"
+
+// A lot of sequences are polynomials in i (1 4 9 16...) or linear recurrences with constant coefficients (Fibonacci, Tower
+// of Hanoi), and those we can solve for rather than search for: finite differences give a polynomial's coefficients, and a
+// recurrence's come from solving the equations S(i) = c1 S(i-1) + ... + ck S(i-k) + c0 which the sequence gives us. That
+// takes microseconds, however long the formula is, where the search would take seconds or minutes, or never get there.
+// The formula is written out in the same reverse polish as the searches' ones, e.g. "3 S(i-1) * S(i-2) -", with only the
+// constants 1 to 9, so a coefficient over 9 has to be a product of them, e.g. 10 i is "2 5 i * *", and one with a prime
+// factor over 9, e.g. 37, can't be written at all.
+// We only believe a solution if it's the only one and the sequence has at least one more number than it took to work it
+// out, which was checked against it, the same as the searches need one number which isn't a seed.
+
+// A polynomial has no seeds, so it's solved for before searching. A recurrence which looks back k numbers needs k seeds,
+// so it's only the answer if there's nothing with fewer. It's solved for before searching too, and then taken at the step
+// which looks back that far, at its attempt, if the steps before that find nothing. The steps with fewer seeds are only
+// searched up to its attempt, since a longer formula with fewer seeds isn't worth the minutes the later attempts take.
+// Either way, the formula goes in *pFound with operators from the first attempt which has all of the ones it uses and
+// room for all its items, and that attempt goes in *pAttempt. It's written the way the depth first search would write it,
+// e.g. "1 i +" rather than "i 1 +", and one which the search would skip for being the same as another, e.g. "2 5 *" for
+// 10, doesn't count, so there's nothing it finds that the search couldn't have. That means no constant term or denominator
+// over 9, and no all-zero sequence. Nor does one too long for any of the attempts.
+
+// Looks for the polynomial in i of the lowest degree which generates the sequence.
+bool SolvePolynomial(const int Seq[], int SeqLen, sFormula *pFound, int *pAttempt);
+
+// Looks for the linear recurrence S(i) = c1 S(i-1) + ... + cOrder S(i-Order), with or without a constant added, which
+// generates the sequence and really does look back Order numbers, i.e. cOrder isn't 0.
+bool SolveRecurrence(const int Seq[], int SeqLen, int Order, sFormula *pFound, int *pAttempt);
@@ -0,0 +1,487 @@
+#include "stdafx.h"
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#ifndef _WIN32
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+#include "Batch.h"
+#include "Daemon.h"
+#include "ResultCache.h"
+#include "Solver.h"
+using namespace std;
+
+#ifdef _WIN32
+
+int RunDaemon(const char *, int, sSolver *, const sSolveControl *, sResultCache *)
+{
+	cerr << "This build doesn't have Unix sockets, so it can't be a server." << endl;
+	return 2;
+}
+
+int RunDaemonClient(const char *, istream&, ostream&)
+{
+	cerr << "This build doesn't have Unix sockets, so it can't be a client." << endl;
+	return 2;
+}
+
+#else
+
+#define DAEMON_LEVELS		16		// How many queues there are. A request which gets to the last one runs until it's finished.
+#define DAEMON_LATENCIES	4096	// How many of the latest requests the latency percentiles are worked out from.
+#define DAEMON_MAX_LINE		4096	// Longer lines are thrown away. No sequence is anywhere near this long.
+#define DAEMON_POLL_MS		200		// How often the listener looks up to see whether it's time to stop.
+
+// A client's connection. The requests from it each hold on to it, so it's only closed once the client has stopped sending
+// and they've all been answered.
+struct sConnection {
+	int		Socket;
+	mutex	WriteLock;	// Any of the workers can be answering.
+
+	~sConnection() { close(Socket); }
+};
+
+// A request which is waiting for a slice of a worker's time.
+typedef struct {
+	shared_ptr<sConnection>	pConnection;
+	long long	LineNum;
+	int			Seq[MAX_SEQ_LEN];
+	int			SeqLen;
+	int			Level;			// Which queue it's in, i.e. how many slices it's had.
+	int			FromMaxRetroS;	// Where the next slice carries on from, or -1s to start at the beginning.
+	int			FromAttempt;
+	double		SolveMs;		// How long its slices have taken between them.
+	chrono::steady_clock::time_point	Arrived;
+	sSolveResult	Result;		// What the last slice found out.
+} sDaemonJob;
+
+typedef struct {
+	sResultCache		*pCache;
+	double				TimeLimitMs;	// For all of a request's slices together. 0 for none.
+	mutex				Lock;			// For everything from here on.
+	condition_variable	NotEmpty;		// Something's been queued, or we're stopping.
+	condition_variable	ReaderGone;
+	deque<sDaemonJob>	Queues[DAEMON_LEVELS];	// Workers take from the first one which isn't empty.
+	int					NumQueued;
+	int					NumRunning;
+	set<sConnection *>	Connections;	// The ones which are still being read from.
+	vector<double>		Latencies;		// From a request arriving to it being answered, for the latest DAEMON_LATENCIES of them.
+	long long			NumAnswered;
+	bool				Stopping;		// Nothing more gets queued, and what's left gets answered with however far it's got.
+	atomic<bool>		Cancel;			// Stops the solves which are running, when we're stopping.
+	atomic<bool>		ShutdownAsked;	// By a client.
+} sDaemon;
+
+// Set by SIGINT or SIGTERM.
+static atomic<bool> DaemonSignalled(false);
+
+static void OnStopSignal(int)
+{
+	DaemonSignalled = true;
+}
+
+static bool SendAll(int Socket, const string& Data)
+{
+	size_t Sent;
+	ssize_t n;
+
+	for (Sent = 0; Sent < Data.size(); Sent += n)
+	{
+		if ((n = send(Socket, Data.data() + Sent, Data.size() - Sent, 0)) <= 0)
+			return false;
+	}
+	return true;
+}
+
+// If the client has gone, there's nobody to tell, so it doesn't matter whether this works.
+static void SendLine(sConnection *pConnection, const string& Line)
+{
+	lock_guard<mutex> Guard(pConnection->WriteLock);
+
+	SendAll(pConnection->Socket, Line + "\n");
+}
+
+// The nearest-rank percentile of Sorted, which mustn't be empty.
+static double Percentile(const vector<double>& Sorted, double Fraction)
+{
+	size_t Rank = (size_t)ceil(Fraction * Sorted.size());
+
+	return Sorted[Rank > 0 ? Rank - 1 : 0];
+}
+
+static string StatsRecord(sDaemon *pDaemon)
+{
+	ostringstream Record;
+	vector<double> Sorted;
+	int NumQueued, NumRunning, NumConnections;
+	long long NumAnswered;
+
+	{
+		lock_guard<mutex> Guard(pDaemon->Lock);
+		Sorted = pDaemon->Latencies;
+		NumQueued = pDaemon->NumQueued;
+		NumRunning = pDaemon->NumRunning;
+		NumConnections = (int)pDaemon->Connections.size();
+		NumAnswered = pDaemon->NumAnswered;
+	}
+	sort(Sorted.begin(), Sorted.end());
+	Record << "{\"stats\":{\"queued\":" << NumQueued << ",\"running\":" << NumRunning << ",\"connections\":" << NumConnections
+		   << ",\"requests\":" << NumAnswered << ",\"latency_ms\":{" << fixed << setprecision(1);
+	if (Sorted.empty())
+		Record << "\"p50\":0,\"p90\":0,\"p99\":0,\"max\":0";
+	else
+		Record << "\"p50\":" << Percentile(Sorted, 0.5) << ",\"p90\":" << Percentile(Sorted, 0.9) << ",\"p99\":" << Percentile(Sorted, 0.99) << ",\"max\":" << Sorted.back();
+	Record << "}}}";
+	return Record.str();
+}
+
+// Queues the job, unless we're stopping. Returns false if it wasn't queued.
+static bool PushJob(sDaemon *pDaemon, sDaemonJob& Job)
+{
+	lock_guard<mutex> Guard(pDaemon->Lock);
+
+	if (pDaemon->Stopping && Job.Level == 0)
+		return false;
+	pDaemon->Queues[Job.Level].push_back(move(Job));
+	pDaemon->NumQueued++;
+	pDaemon->NotEmpty.notify_one();
+	return true;
+}
+
+// Waits for a job from the first queue which has one. Returns false when we're stopping and there are none left.
+static bool PopJob(sDaemon *pDaemon, sDaemonJob *pJob)
+{
+	unique_lock<mutex> Guard(pDaemon->Lock);
+	int Level;
+
+	pDaemon->NotEmpty.wait(Guard, [pDaemon]() { return pDaemon->NumQueued > 0 || pDaemon->Stopping; });
+	if (pDaemon->NumQueued == 0)
+		return false;
+	for (Level = 0; pDaemon->Queues[Level].empty(); Level++)
+		;
+	*pJob = move(pDaemon->Queues[Level].front());
+	pDaemon->Queues[Level].pop_front();
+	pDaemon->NumQueued--;
+	pDaemon->NumRunning++;
+	return true;
+}
+
+static void AnswerJob(sDaemon *pDaemon, sDaemonJob *pJob)
+{
+	double LatencyMs = chrono::duration<double, milli>(chrono::steady_clock::now() - pJob->Arrived).count();
+
+	pJob->Result.ElapsedMs = pJob->SolveMs;
+	SendLine(pJob->pConnection.get(), MakeResultRecord(pJob->LineNum, pJob->Seq, pJob->SeqLen, &pJob->Result));
+	pJob->pConnection.reset();
+
+	lock_guard<mutex> Guard(pDaemon->Lock);
+	if (pDaemon->Latencies.size() < DAEMON_LATENCIES)
+		pDaemon->Latencies.push_back(LatencyMs);
+	else
+		pDaemon->Latencies[pDaemon->NumAnswered % DAEMON_LATENCIES] = LatencyMs;
+	pDaemon->NumAnswered++;
+	pDaemon->NumRunning--;
+}
+
+// Gives the job one slice of time, carrying on from where the last one got to. The cache remembers that by itself.
+static void RunSlice(sDaemon *pDaemon, sSolver *pSolver, sDaemonJob *pJob, const sSolveControl *pControl)
+{
+	if (pDaemon->pCache != nullptr || pJob->FromMaxRetroS < 0)
+		SolveSequenceCached(pDaemon->pCache, pSolver, pJob->Seq, pJob->SeqLen, false, pControl, &pJob->Result);
+	else
+		ResumeSolveSequence(pSolver, pJob->Seq, pJob->SeqLen, pJob->FromMaxRetroS, pJob->FromAttempt, false, pControl, &pJob->Result);
+}
+
+static void SolveJobs(sDaemon *pDaemon, sSolver *pSolver)
+{
+	sDaemonJob Job;
+	sSolveControl Control;
+	double SliceMs;
+
+	Control.pCancel = &pDaemon->Cancel;
+	Control.ProgressIntervalMs = 0;
+	Control.CheckpointIntervalMs = 0;
+	while (PopJob(pDaemon, &Job))
+	{
+		SliceMs = Job.Level < DAEMON_LEVELS - 1 ? DAEMON_FIRST_SLICE_MS * (double)(1 << Job.Level) : 0;
+		if (pDaemon->TimeLimitMs > 0)
+			SliceMs = SliceMs > 0 ? min(SliceMs, pDaemon->TimeLimitMs - Job.SolveMs) : pDaemon->TimeLimitMs - Job.SolveMs;
+		Control.TimeLimitMs = SliceMs;
+		RunSlice(pDaemon, pSolver, &Job, &Control);
+		Job.SolveMs += Job.Result.ElapsedMs;
+		if (Job.Result.Stopped && !pDaemon->Cancel && (pDaemon->TimeLimitMs == 0 || Job.SolveMs < pDaemon->TimeLimitMs))
+		{
+			// Out of time for now. If it found a formula, the simpler ones in the same step might not all have been ruled
+			// out, so that step gets searched again.
+			if (Job.Result.Attempt >= 0)
+			{
+				Job.FromMaxRetroS = Job.Result.MaxRetroS;
+				Job.FromAttempt = Job.Result.Attempt + (Job.Result.Success ? 0 : 1);
+			}
+			Job.Level++;
+			{
+				lock_guard<mutex> Guard(pDaemon->Lock);
+				pDaemon->NumRunning--;
+			}
+			if (PushJob(pDaemon, Job))
+				continue;
+		}
+		AnswerJob(pDaemon, &Job);
+	}
+}
+
+// Handles a line from a client. Requests are answered when they've been solved, and everything else straight away.
+static void HandleLine(sDaemon *pDaemon, const shared_ptr<sConnection>& pConnection, long long LineNum, const string& Line)
+{
+	sDaemonJob Job;
+
+	if (Line.find_first_not_of(", \t") == string::npos)
+		return;
+	if (Line == "stats")
+	{
+		SendLine(pConnection.get(), StatsRecord(pDaemon));
+		return;
+	}
+	if (Line == "shutdown")
+	{
+		pDaemon->ShutdownAsked = true;
+		SendLine(pConnection.get(), "{\"line\":" + to_string(LineNum) + ",\"status\":\"shutting_down\"}");
+		return;
+	}
+	Job.SeqLen = ParseSequence(Line, Job.Seq);
+	Job.Result.Success = false;
+	Job.Result.Stopped = false;
+	if (Job.SeqLen < 2)
+	{
+		SendLine(pConnection.get(), MakeResultRecord(LineNum, Job.Seq, Job.SeqLen, &Job.Result));
+		return;
+	}
+	Job.pConnection = pConnection;
+	Job.LineNum = LineNum;
+	Job.Level = 0;
+	Job.FromMaxRetroS = -1;
+	Job.FromAttempt = -1;
+	Job.SolveMs = 0;
+	Job.Arrived = chrono::steady_clock::now();
+	if (!PushJob(pDaemon, Job))
+		SendLine(pConnection.get(), "{\"line\":" + to_string(LineNum) + ",\"status\":\"shutting_down\"}");
+}
+
+// Reads lines from the client until it stops sending, or we stop.
+static void ReadRequests(sDaemon *pDaemon, shared_ptr<sConnection> pConnection)
+{
+	char Buffer[4096];
+	string Line;
+	long long LineNum = 0;
+	bool TooLong = false;
+	ssize_t n, c;
+
+	while ((n = recv(pConnection->Socket, Buffer, sizeof(Buffer), 0)) > 0)
+	{
+		for (c = 0; c < n; c++)
+		{
+			if (Buffer[c] == '\n')
+			{
+				LineNum++;
+				if (!Line.empty() && Line.back() == '\r')
+					Line.pop_back();
+				if (!TooLong)
+					HandleLine(pDaemon, pConnection, LineNum, Line);
+				Line.clear();
+				TooLong = false;
+			}
+			else if (Line.size() < DAEMON_MAX_LINE)
+			{
+				Line += Buffer[c];
+			}
+			else
+			{
+				TooLong = true;
+			}
+		}
+	}
+
+	// The last thing we do, since RunDaemon() returns as soon as there are no readers left. Our pConnection goes after
+	// that, which doesn't matter since it's not part of the daemon.
+	lock_guard<mutex> Guard(pDaemon->Lock);
+	pDaemon->Connections.erase(pConnection.get());
+	pDaemon->ReaderGone.notify_all();
+}
+
+// Removes what's left of a server which didn't shut down properly, but not a server which is still running, or anything
+// which isn't a socket. Returns false if there's still something there.
+static bool RemoveStaleSocket(const char *SocketPath, const sockaddr_un *pAddress)
+{
+	struct stat Info;
+	int Probe;
+	bool InUse;
+
+	if (stat(SocketPath, &Info) != 0)
+		return true;
+	if (!S_ISSOCK(Info.st_mode))
+		return false;
+	Probe = socket(AF_UNIX, SOCK_STREAM, 0);
+	InUse = Probe >= 0 && connect(Probe, (const sockaddr *)pAddress, sizeof(*pAddress)) == 0;
+	if (Probe >= 0)
+		close(Probe);
+	return !InUse && unlink(SocketPath) == 0;
+}
+
+static bool MakeAddress(const char *SocketPath, sockaddr_un *pAddress)
+{
+	memset(pAddress, 0, sizeof(*pAddress));
+	pAddress->sun_family = AF_UNIX;
+	if (strlen(SocketPath) >= sizeof(pAddress->sun_path))
+		return false;
+	strcpy(pAddress->sun_path, SocketPath);
+	return true;
+}
+
+int RunDaemon(const char *SocketPath, int NumWorkers, sSolver *pSolver, const sSolveControl *pControl, sResultCache *pCache)
+{
+	sDaemon Daemon;
+	sockaddr_un Address;
+	vector<thread> Workers;
+	vector<sSolver> Solvers;
+	struct pollfd Poll;
+	int Listener, Socket, w;
+
+	if (!MakeAddress(SocketPath, &Address) || !RemoveStaleSocket(SocketPath, &Address))
+	{
+		cerr << "Can't use " << SocketPath << " (is another server using it?)" << endl;
+		return 2;
+	}
+	if ((Listener = socket(AF_UNIX, SOCK_STREAM, 0)) < 0
+	 || ::bind(Listener, (const sockaddr *)&Address, sizeof(Address)) != 0
+	 || listen(Listener, SOMAXCONN) != 0)
+	{
+		cerr << "Can't listen on " << SocketPath << endl;
+		if (Listener >= 0)
+			close(Listener);
+		return 2;
+	}
+	// A client which hangs up before it's answered mustn't kill us.
+	signal(SIGPIPE, SIG_IGN);
+	DaemonSignalled = false;
+	signal(SIGINT, OnStopSignal);
+	signal(SIGTERM, OnStopSignal);
+
+	Daemon.pCache = pCache;
+	Daemon.TimeLimitMs = pControl != nullptr ? pControl->TimeLimitMs : 0;
+	Daemon.NumQueued = 0;
+	Daemon.NumRunning = 0;
+	Daemon.NumAnswered = 0;
+	Daemon.Stopping = false;
+	Daemon.Cancel = false;
+	Daemon.ShutdownAsked = false;
+	if (NumWorkers < 1)
+		NumWorkers = 1;
+	// Like batch mode, each worker has its own solver with a share of the threads.
+	Solvers.assign(NumWorkers, *pSolver);
+	for (w = 0; w < NumWorkers; w++)
+	{
+		Solvers[w].NumThreads = max(pSolver->NumThreads / NumWorkers, 1);
+		Solvers[w].Rejections.Rejected = 0;
+		Workers.emplace_back(SolveJobs, &Daemon, &Solvers[w]);
+	}
+	cerr << "Listening on " << SocketPath << " with " << NumWorkers << " workers." << endl;
+
+	Poll.fd = Listener;
+	Poll.events = POLLIN;
+	while (!DaemonSignalled && !Daemon.ShutdownAsked)
+	{
+		if (poll(&Poll, 1, DAEMON_POLL_MS) <= 0 || (Socket = accept(Listener, nullptr, nullptr)) < 0)
+			continue;
+		shared_ptr<sConnection> pConnection = make_shared<sConnection>();
+		pConnection->Socket = Socket;
+		{
+			lock_guard<mutex> Guard(Daemon.Lock);
+			Daemon.Connections.insert(pConnection.get());
+		}
+		thread(ReadRequests, &Daemon, pConnection).detach();
+	}
+
+	// Answer whatever we've got with however far it's got, and stop reading.
+	{
+		lock_guard<mutex> Guard(Daemon.Lock);
+		Daemon.Stopping = true;
+		Daemon.Cancel = true;
+		for (sConnection *pConnection : Daemon.Connections)
+			shutdown(pConnection->Socket, SHUT_RD);
+	}
+	Daemon.NotEmpty.notify_all();
+	for (w = 0; w < NumWorkers; w++)
+	{
+		Workers[w].join();
+		pSolver->Rejections.Rejected += Solvers[w].Rejections.Rejected;
+	}
+	{
+		unique_lock<mutex> Guard(Daemon.Lock);
+		Daemon.ReaderGone.wait(Guard, [&Daemon]() { return Daemon.Connections.empty(); });
+	}
+	close(Listener);
+	unlink(SocketPath);
+	signal(SIGINT, SIG_DFL);
+	signal(SIGTERM, SIG_DFL);
+	cerr << "Stopped after answering " << Daemon.NumAnswered << " requests." << endl;
+	return 0;
+}
+
+int RunDaemonClient(const char *SocketPath, istream& In, ostream& Out)
+{
+	sockaddr_un Address;
+	char Buffer[4096];
+	ssize_t n;
+	int Socket;
+
+	if (!MakeAddress(SocketPath, &Address)
+	 || (Socket = socket(AF_UNIX, SOCK_STREAM, 0)) < 0)
+	{
+		cerr << "Can't connect to " << SocketPath << endl;
+		return 2;
+	}
+	if (connect(Socket, (const sockaddr *)&Address, sizeof(Address)) != 0)
+	{
+		cerr << "Can't connect to " << SocketPath << " (is the server running?)" << endl;
+		close(Socket);
+		return 2;
+	}
+	signal(SIGPIPE, SIG_IGN);
+	// Send while we receive, so neither end waits for the other with a full buffer. The server answers everything we sent
+	// before it closes the connection.
+	thread Sender([Socket, &In]()
+	{
+		string Line;
+
+		while (getline(In, Line) && SendAll(Socket, Line + "\n"))
+			;
+		shutdown(Socket, SHUT_WR);
+	});
+	while ((n = recv(Socket, Buffer, sizeof(Buffer), 0)) > 0)
+	{
+		Out.write(Buffer, n);
+		Out.flush();
+	}
+	Sender.join();
+	close(Socket);
+	return 0;
+}
+
+#endif
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <iostream>
+#include "ResultCache.h"
+#include "Solver.h"
+
+#define DAEMON_FIRST_SLICE_MS	50	// How long a request gets to start with. Each slice after that is twice as long.
+
+// Server mode. Listens on the Unix socket SocketPath for connections, each of which sends sequences one per line, like
+// batch mode's input, and gets a record like batch mode's (see Batch.h) for each one as it's solved. "line" is the line
+// number within that connection. Everything we set up once (the solver's library, the cache, the workers' threads) stays
+// there between requests, so a request costs no more than its search.
+// NumWorkers threads solve the requests. So that quick ones don't wait behind one that takes minutes, a solve only gets a
+// short slice of time (DAEMON_FIRST_SLICE_MS) at first. If it doesn't finish, it goes to the back of the next queue down,
+// which is only looked at when the ones above are empty, and gets twice as long next time, carrying on from the last step it
+// got all the way through. pControl's time limit (if pControl isn't nullptr) is for all of a request's slices together.
+// A line which is just "stats" gets a record of how many requests are waiting and how long the recent ones took, e.g.
+//	{"stats":{"queued":2,"running":4,"connections":3,"requests":180,"latency_ms":{"p50":0.9,"p90":51.2,"p99":2210.4,"max":3015.0}}}
+// and "shutdown" stops the server, after answering the requests it has with however far they've got (so usually "timeout"
+// for the ones still going). So does SIGINT or SIGTERM.
+// Only builds with Unix sockets have it. Returns 0, or 2 if it couldn't listen on SocketPath.
+int RunDaemon(const char *SocketPath, int NumWorkers, sSolver *pSolver, const sSolveControl *pControl, sResultCache *pCache);
+
+// A client for RunDaemon(), for testing. Sends every line of In to the server at SocketPath and writes what comes back to
+// Out until the server has answered them all. Returns 0, or 2 if it couldn't connect.
+int RunDaemonClient(const char *SocketPath, std::istream& In, std::ostream& Out);
@@ -0,0 +1,374 @@
+#include "stdafx.h"
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <vector>
+#include "BottomUp.h"
+#include "FormulaLibrary.h"
+#include "Operators.h"
+#include "SearchLimits.h"
+#include "Solver.h"
+using namespace std;
+
+#define LIBRARY_MAGIC			0x4C424753	// "SGBL" when you look at the file.
+#define LATENCY_TEST_SEQUENCES	1000		// How many of its own formulae we look up to see how quick the library is.
+
+
+static uint32_t PrefixHash(const int32_t Prefix[], int PrefixLen)
+{
+	uint64_t Hash = PrefixLen;
+	int n;
+
+	for (n = 0; n < PrefixLen; n++)
+	{
+		Hash = (Hash ^ (uint32_t)Prefix[n]) * 0x9E3779B97F4A7C15ull;
+		Hash ^= Hash >> 29;
+	}
+	return (uint32_t)(Hash ^ (Hash >> 32));
+}
+
+// Whether the values are all whole numbers which fit in an int, since otherwise they can't be the user's numbers.
+static bool ValuesAreInts(const double Row[], int Len, int32_t Ints[])
+{
+	int n;
+
+	for (n = 0; n < Len; n++)
+	{
+		if (Row[n] != floor(Row[n]) || Row[n] < INT32_MIN || Row[n] > INT32_MAX)
+			return false;
+		Ints[n] = (int32_t)Row[n];
+	}
+	return true;
+}
+
+// Works out the values of the operator at every position into Row[]. Returns false if any of them are nonsense, since
+// with no seeds, every position matters.
+static bool LibraryOperatorValues(eOperatorKind Kind, const double *pLeft, const double *pRight, int RowLen, double Row[])
+{
+	tLanes Value;
+	unsigned int Wanted;
+	int Pos;
+
+	for (Pos = 0; Pos < RowLen; Pos += NUM_LANES)
+	{
+		Value = ApplyAnyOperator(Kind, pLeft != nullptr ? LanesLoadUnaligned(pLeft + Pos) : LanesSet(0), LanesLoadUnaligned(pRight + Pos));
+		Wanted = LanesBetween(Pos, 0, LIBRARY_POSITIONS);
+		if ((LanesFinite(Value) & Wanted) != Wanted)
+			return false;
+		LanesStore(&Row[Pos], Value);
+	}
+	return true;
+}
+
+// Keeps the expression unless we've already got one which gives the same values, and if we do keep it, and the numbers it
+// starts with could be the user's, it goes in the library.
+static void KeepExpression(sExpressionTable *pTable, const sExpression *pExpr, double Row[], const sSearchLimits *pLimits, int PrefixLen, vector<sLibraryEntry> *pEntries)
+{
+	size_t NumKept = pTable->Expressions.size();
+	sLibraryEntry Entry;
+	sFormula Formula;
+	int inum;
+
+	// It's checked against the sequence in pLimits too, but there isn't one, so never mind what it says.
+	ConsiderExpression(pTable, pExpr, Row, true, pLimits);
+	memset(&Entry, 0, sizeof(Entry));
+	if (pTable->Expressions.size() == NumKept || !ValuesAreInts(Row, PrefixLen, Entry.Prefix))
+		return;
+	ExpressionToFormula(pTable, &pTable->Expressions.back(), &Formula);
+	Entry.NumItems = Formula.NumItems;
+	for (inum = 0; inum < Formula.NumItems; inum++)
+	{
+		Entry.Items[inum][0] = Formula.Items[inum].ItemType;
+		Entry.Items[inum][1] = Formula.Items[inum].Index;
+	}
+	pEntries->push_back(Entry);
+}
+
+// Builds up every formula of up to MaxItems items without S(i-k), smallest first, the same way as BottomUpSearch(), and
+// puts the ones worth having in *pEntries. Returns the length up to which it got all of them, which is less than MaxItems
+// if it ran out of memory.
+static int EnumerateLibraryFormulae(const sOperator* const* Operators, int NumOperators, int MaxItems, int PrefixLen, vector<sLibraryEntry> *pEntries, size_t *pNumKept)
+{
+	sSearchLimits Limits;
+	sExpressionTable Table;
+	sExpression Expr;
+	alignas(LANES_ALIGNMENT) double Row[NUM_POSITIONS];
+	eOperatorKind Kinds[NUM_OPERATOR_KINDS];
+	int FirstOfSize[MAX_POSS_ITEMS_IN_EXPRESSION + 2];	// The expressions of n items are FirstOfSize[n]..FirstOfSize[n+1]-1.
+	int NumItems, LeftItems, RightItems, Op, l, r, i;
+	bool Commutes;
+
+	// There's no sequence, just the positions.
+	for (i = 0; i < NUM_POSITIONS; i++)
+	{
+		Limits.SeqLanes[i] = Limits.SeqLanes[NUM_POSITIONS + i] = 0;
+		Limits.Positions[i] = i;
+	}
+	FillRunningTotals(&Limits);
+	Limits.pSeq = nullptr;
+	Limits.SeqLen = LIBRARY_POSITIONS - 1;
+	Limits.MaxItemsInExpression = MaxItems;
+	Limits.NumIndexValsForItem[CONSTANT] = 9;
+	Limits.NumIndexValsForItem[S] = 0;
+	Limits.NumIndexValsForItem[I] = 0;
+	Limits.NumIndexValsForItem[OPERATOR] = NumOperators;
+	Limits.NeedNewestS = false;
+	Limits.NumOldOperators = 0;
+	Limits.OldMaxItems = 0;
+	Limits.pWatch = nullptr;
+	Limits.pRejections = nullptr;
+	for (Op = 0; Op < NumOperators; Op++)
+		Kinds[Op] = OperatorKindOf(Operators[Op]);
+
+	InitExpressionTable(&Table, Limits.SeqLen, LIBRARY_MAX_BYTES);
+	FirstOfSize[1] = 0;
+	Expr.NumItems = 1;
+	Expr.Left = Expr.Right = -1;
+	Expr.FirstPos = 0;
+	Expr.Novelty = 0;
+	for (Expr.Item.ItemType = CONSTANT; Expr.Item.ItemType != OPERATOR; Expr.Item.ItemType = static_cast<eItemType>(Expr.Item.ItemType + 1))
+	{
+		if (Expr.Item.ItemType == S)
+			continue;
+		for (Expr.Item.Index = 0; Expr.Item.Index == 0 || Expr.Item.Index < Limits.NumIndexValsForItem[Expr.Item.ItemType]; Expr.Item.Index++)
+		{
+			LeafValues(&Expr.Item, &Limits, Row);
+			KeepExpression(&Table, &Expr, Row, &Limits, PrefixLen, pEntries);
+		}
+	}
+	FirstOfSize[2] = (int)Table.Expressions.size();
+
+	Expr.Item.ItemType = OPERATOR;
+	for (NumItems = 2; NumItems <= MaxItems; NumItems++)
+	{
+		Expr.NumItems = NumItems;
+		for (Op = 0; Op < NumOperators; Op++)
+		{
+			Expr.Item.Index = Op;
+			if (OperatorAlgebra[Kinds[Op]].Aggregate)
+			{
+				// Without S(i-k), the only thing an aggregate can go on is i.
+				Expr.Left = -1;
+				for (r = FirstOfSize[1]; NumItems == 2 && r < FirstOfSize[2]; r++)
+				{
+					Expr.Right = r;
+					if (Table.Expressions[r].Item.ItemType == I && AggregateValues(Kinds[Op] == PRODUCT_OP, &Table.Expressions[r].Item, 0, &Limits, Row))
+						KeepExpression(&Table, &Expr, Row, &Limits, PrefixLen, pEntries);
+				}
+				continue;
+			}
+			if (sOperatorTable::ByKind[Kinds[Op]].NumOperands == 1)
+			{
+				Expr.Left = -1;
+				for (r = FirstOfSize[NumItems - 1]; r < FirstOfSize[NumItems]; r++)
+				{
+					Expr.Right = r;
+					if (LibraryOperatorValues(Kinds[Op], nullptr, ExpressionValues(&Table, r), Table.RowLen, Row))
+						KeepExpression(&Table, &Expr, Row, &Limits, PrefixLen, pEntries);
+				}
+				continue;
+			}
+			// a+b and b+a give the same values so only build one of them.
+			Commutes = OperatorAlgebra[Kinds[Op]].Commutative;
+			for (LeftItems = 1; LeftItems < NumItems - 1; LeftItems++)
+			{
+				RightItems = NumItems - 1 - LeftItems;
+				if (Commutes && LeftItems > RightItems)
+					break;
+				for (l = FirstOfSize[LeftItems]; l < FirstOfSize[LeftItems + 1]; l++)
+				{
+					Expr.Left = l;
+					for (r = Commutes && LeftItems == RightItems ? l : FirstOfSize[RightItems]; r < FirstOfSize[RightItems + 1]; r++)
+					{
+						Expr.Right = r;
+						if (LibraryOperatorValues(Kinds[Op], ExpressionValues(&Table, l), ExpressionValues(&Table, r), Table.RowLen, Row))
+							KeepExpression(&Table, &Expr, Row, &Limits, PrefixLen, pEntries);
+					}
+				}
+			}
+		}
+		*pNumKept = Table.Expressions.size();
+		if (Table.Full)
+			return NumItems - 1;
+		FirstOfSize[NumItems + 1] = (int)Table.Expressions.size();
+	}
+	return MaxItems;
+}
+
+// Sorts the entries into their buckets, keeping them in order within each one, and writes out the library.
+static bool WriteLibrary(const char *FileName, const sLibraryHeader *pHeader, const vector<sLibraryEntry>& Entries)
+{
+	vector<uint32_t> FirstEntry(pHeader->NumBuckets + 1, 0);
+	vector<sLibraryEntry> Sorted(Entries.size());
+	vector<uint32_t> Next;
+	uint32_t b;
+	size_t e;
+
+	for (e = 0; e < Entries.size(); e++)
+		FirstEntry[(PrefixHash(Entries[e].Prefix, pHeader->PrefixLen) & (pHeader->NumBuckets - 1)) + 1]++;
+	for (b = 0; b < pHeader->NumBuckets; b++)
+		FirstEntry[b + 1] += FirstEntry[b];
+	Next.assign(FirstEntry.begin(), FirstEntry.end() - 1);
+	for (e = 0; e < Entries.size(); e++)
+		Sorted[Next[PrefixHash(Entries[e].Prefix, pHeader->PrefixLen) & (pHeader->NumBuckets - 1)]++] = Entries[e];
+
+	ofstream Out(FileName, ios::binary | ios::trunc);
+	Out.write((const char *)pHeader, sizeof(*pHeader));
+	Out.write((const char *)&FirstEntry[0], FirstEntry.size() * sizeof(FirstEntry[0]));
+	if (!Sorted.empty())
+		Out.write((const char *)&Sorted[0], Sorted.size() * sizeof(Sorted[0]));
+	return Out.good();
+}
+
+// Looks up a sample of the library's own formulae, a few numbers longer than the index needs, and reports how long it takes.
+static void ReportLookUpTime(const char *FileName, const vector<sLibraryEntry>& Entries, int Attempt, int MaxItems, int PrefixLen, ostream& Report)
+{
+	sFormulaLibrary Library;
+	vector<vector<int>> Tests;
+	sFormula Formula, Found;
+	int Seq[MAX_SEQ_LEN];
+	int t, inum, n, NumFound;
+	int NumOperators;
+	chrono::steady_clock::time_point StartTime;
+	double ElapsedUs;
+
+	Formula.Operators = AttemptOperators(Attempt, &NumOperators);
+	for (t = 0; t < LATENCY_TEST_SEQUENCES && t < (int)Entries.size(); t++)
+	{
+		const sLibraryEntry& Entry = Entries[Entries.size() * t / min((size_t)LATENCY_TEST_SEQUENCES, Entries.size())];
+		Formula.NumItems = Entry.NumItems;
+		for (inum = 0; inum < Entry.NumItems; inum++)
+		{
+			Formula.Items[inum].ItemType = (eItemType)Entry.Items[inum][0];
+			Formula.Items[inum].Index = Entry.Items[inum][1];
+		}
+		// Carry on the sequence for as long as it stays in whole numbers.
+		memcpy(Seq, Entry.Prefix, PrefixLen * sizeof(Seq[0]));
+		for (n = PrefixLen; n < PrefixLen + 3 && FormulaGeneratesSequence(&Formula, Seq, n) && Formula.NextNum >= INT32_MIN && Formula.NextNum <= INT32_MAX; n++)
+		{
+			Seq[n] = (int)Formula.NextNum;
+		}
+		Tests.push_back(vector<int>(Seq, Seq + n));
+	}
+
+	if (!OpenFormulaLibrary(FileName, &Library))
+	{
+		Report << "Can't open the library we just wrote!" << endl;
+		return;
+	}
+	StartTime = chrono::steady_clock::now();
+	for (t = 0, NumFound = 0; t < (int)Tests.size(); t++)
+		NumFound += LookUpFormula(&Library, &Tests[t][0], (int)Tests[t].size(), Attempt, MaxItems, &Found);
+	ElapsedUs = chrono::duration<double, micro>(chrono::steady_clock::now() - StartTime).count();
+	CloseFormulaLibrary(&Library);
+	if (!Tests.empty())
+	{
+		Report << "A look-up takes " << fixed << setprecision(2) << ElapsedUs / Tests.size() << " us on average ("
+			   << NumFound << " of " << Tests.size() << " sample sequences found)." << endl;
+	}
+}
+
+bool BuildFormulaLibrary(const char *FileName, int Attempt, int MaxItems, int PrefixLen, ostream& Report)
+{
+	chrono::steady_clock::time_point StartTime = chrono::steady_clock::now();
+	const sOperator* const* Operators;
+	vector<sLibraryEntry> Entries;
+	sLibraryHeader Header;
+	size_t NumKept = 0;
+	int NumOperators;
+
+	Operators = AttemptOperators(Attempt, &NumOperators);
+	if (Operators == nullptr || MaxItems < 1 || MaxItems > MAX_POSS_ITEMS_IN_EXPRESSION || PrefixLen < 1 || PrefixLen > LIBRARY_MAX_PREFIX)
+		return false;
+
+	memset(&Header, 0, sizeof(Header));
+	Header.Magic = LIBRARY_MAGIC;
+	Header.EntrySize = sizeof(sLibraryEntry);
+	Header.Fingerprint = AttemptsFingerprint();
+	Header.Attempt = Attempt;
+	Header.PrefixLen = PrefixLen;
+	Header.MaxItems = EnumerateLibraryFormulae(Operators, NumOperators, MaxItems, PrefixLen, &Entries, &NumKept);
+	Header.NumEntries = (uint32_t)Entries.size();
+	for (Header.NumBuckets = 1; Header.NumBuckets < Header.NumEntries; Header.NumBuckets *= 2)
+		;
+	if (!WriteLibrary(FileName, &Header, Entries))
+		return false;
+
+	Report << "Built " << FileName << " in " << fixed << setprecision(1) << chrono::duration<double>(chrono::steady_clock::now() - StartTime).count() << " s." << endl;
+	if (Header.MaxItems < MaxItems)
+		Report << "Ran out of memory, so it only has all the formulae up to " << Header.MaxItems << " items." << endl;
+	Report << NumKept << " different formulae, of which " << Entries.size() << " start with " << PrefixLen << " whole numbers and are in the index." << endl;
+	Report << "It takes " << sizeof(Header) + (Header.NumBuckets + 1) * sizeof(uint32_t) + Entries.size() * sizeof(sLibraryEntry) << " bytes." << endl;
+	ReportLookUpTime(FileName, Entries, Attempt, MaxItems, PrefixLen, Report);
+	return true;
+}
+
+bool OpenFormulaLibrary(const char *FileName, sFormulaLibrary *pLibrary)
+{
+	const sLibraryHeader *pHeader;
+	unsigned long long Length;
+
+	if (!OpenMappedFile(FileName, false, &pLibrary->File))
+		return false;
+	if (!MappedFileLength(&pLibrary->File, &Length) || Length < sizeof(sLibraryHeader) || !MapFile(&pLibrary->File, (size_t)Length))
+	{
+		CloseMappedFile(&pLibrary->File);
+		return false;
+	}
+	pHeader = (const sLibraryHeader *)pLibrary->File.pData;
+	pLibrary->pHeader = pHeader;
+	pLibrary->FirstEntry = (const uint32_t *)(pHeader + 1);
+	pLibrary->Entries = (const sLibraryEntry *)(pLibrary->FirstEntry + pHeader->NumBuckets + 1);
+	if (pHeader->Magic != LIBRARY_MAGIC
+	 || pHeader->EntrySize != sizeof(sLibraryEntry)
+	 || pHeader->Fingerprint != AttemptsFingerprint()
+	 || pHeader->PrefixLen < 1 || pHeader->PrefixLen > LIBRARY_MAX_PREFIX
+	 || pHeader->NumBuckets == 0 || (pHeader->NumBuckets & (pHeader->NumBuckets - 1)) != 0
+	 || Length != sizeof(sLibraryHeader) + (pHeader->NumBuckets + 1ull) * sizeof(uint32_t) + (unsigned long long)pHeader->NumEntries * sizeof(sLibraryEntry)
+	 || pLibrary->FirstEntry[pHeader->NumBuckets] != pHeader->NumEntries)
+	{
+		CloseMappedFile(&pLibrary->File);
+		return false;
+	}
+	return true;
+}
+
+void CloseFormulaLibrary(sFormulaLibrary *pLibrary)
+{
+	CloseMappedFile(&pLibrary->File);
+}
+
+bool LookUpFormula(const sFormulaLibrary *pLibrary, const int Seq[], int SeqLen, int Attempt, int MaxItems, sFormula *pFound)
+{
+	const sLibraryEntry *pEntry;
+	int32_t Prefix[LIBRARY_MAX_PREFIX];
+	uint32_t e, Bucket;
+	int inum, PrefixLen, NumOperators;
+
+	if (pLibrary == nullptr || SeqLen < (PrefixLen = pLibrary->pHeader->PrefixLen))
+		return false;
+	if ((pFound->Operators = AttemptOperators(Attempt, &NumOperators)) == nullptr)
+		return false;
+	for (inum = 0; inum < PrefixLen; inum++)
+		Prefix[inum] = Seq[inum];
+	Bucket = PrefixHash(Prefix, PrefixLen) & (pLibrary->pHeader->NumBuckets - 1);
+	for (e = pLibrary->FirstEntry[Bucket]; e < pLibrary->FirstEntry[Bucket + 1]; e++)
+	{
+		pEntry = &pLibrary->Entries[e];
+		if (pEntry->NumItems > MaxItems || memcmp(pEntry->Prefix, Prefix, PrefixLen * sizeof(Prefix[0])) != 0)
+			continue;
+		// The attempts' operators all start the same way, so the indices mean the same to any attempt which has them.
+		for (inum = 0; inum < pEntry->NumItems && (pEntry->Items[inum][0] != OPERATOR || pEntry->Items[inum][1] < NumOperators); inum++)
+		{
+			pFound->Items[inum].ItemType = (eItemType)pEntry->Items[inum][0];
+			pFound->Items[inum].Index = pEntry->Items[inum][1];
+		}
+		pFound->NumItems = inum;
+		if (inum == pEntry->NumItems && FormulaGeneratesSequence(pFound, Seq, SeqLen))
+			return true;
+	}
+	return false;
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <stdint.h>
+#include <iostream>
+#include "MappedFile.h"
+#include "Solver.h"
+
+// Formulae which don't refer back to earlier numbers in the sequence only depend on i, so the numbers they generate are
+// the same whatever the user gives us. The library is all of them up to some length, worked out once and saved, indexed by
+// the first few numbers they generate. When the search gets to an attempt with no seeds, it looks there first, which only
+// takes as long as checking the handful of formulae which start off with the user's numbers.
+// Like the bottom-up search, it only keeps the shortest formula for each set of numbers.
+
+#define LIBRARY_MAX_PREFIX	8	// The most numbers the index can be keyed on.
+#define LIBRARY_POSITIONS	16	// Formulae which generate the same numbers for this many positions are taken to be the same.
+								// They're made of a few small numbers and i, so they'd have to be very long to be wrong.
+#define LIBRARY_MAX_BYTES	((size_t)1 << 30)	// How much memory building a library may use.
+
+typedef struct {
+	int32_t		Prefix[LIBRARY_MAX_PREFIX];	// The numbers the formula generates for i = 0, 1, 2... Only the first PrefixLen count.
+	uint8_t		NumItems;
+	uint8_t		Items[MAX_POSS_ITEMS_IN_EXPRESSION][2];	// Each item's type and index. OPERATOR indices are into the
+														// operators of the attempt the library was built for.
+} sLibraryEntry;
+
+// The file is this, then NumBuckets + 1 uint32s saying where each bucket's entries start (the last being where they
+// all end), then the entries. An entry goes in the bucket its prefix hashes to, shortest formulae first.
+typedef struct {
+	uint32_t	Magic;
+	uint32_t	EntrySize;
+	uint64_t	Fingerprint;	// AttemptsFingerprint() when it was built, since OPERATOR indices depend on the attempts.
+	int32_t		Attempt;		// Whose operators it was built with.
+	int32_t		MaxItems;		// It has every formula up to this long.
+	int32_t		PrefixLen;		// How many numbers the index is keyed on.
+	uint32_t	NumBuckets;		// A power of 2.
+	uint32_t	NumEntries;
+	uint32_t	Unused;
+} sLibraryHeader;
+
+typedef struct sFormulaLibrary {
+	sMappedFile				File;
+	const sLibraryHeader	*pHeader;
+	const uint32_t			*FirstEntry;
+	const sLibraryEntry		*Entries;
+} sFormulaLibrary;
+
+// Works out every formula of up to MaxItems items with no S(i-k), using the operators of Attempt, and saves them in
+// FileName. How long it took, how big it is and how quick it is to look things up in it are written to Report.
+bool BuildFormulaLibrary(const char *FileName, int Attempt, int MaxItems, int PrefixLen, std::ostream& Report);
+
+// Opens a library which BuildFormulaLibrary() made. Fails if it was made for different attempts.
+bool OpenFormulaLibrary(const char *FileName, sFormulaLibrary *pLibrary);
+
+void CloseFormulaLibrary(sFormulaLibrary *pLibrary);
+
+// Looks in pLibrary (which may be nullptr, for no library) for the shortest formula which generates the sequence, using no
+// more than MaxItems items and only the operators of Attempt. The library is only read, so any number of threads can look
+// things up in it at once.
+bool LookUpFormula(const sFormulaLibrary *pLibrary, const int Seq[], int SeqLen, int Attempt, int MaxItems, sFormula *pFound);
@@ -0,0 +1,100 @@
+#pragma once
+
+// A vector of doubles with one lane per position in the sequence, so a formula can be evaluated at several positions at once.
+// Uses the widest instruction set the compiler has been told it can use (e.g. /arch:AVX2 or /arch:AVX512), falling back to
+// SSE2, which every x64 processor has, or to plain doubles (1 lane) on anything else.
+// Arrays of lanes must be aligned to LANES_ALIGNMENT and their lengths rounded up with LANES_ROUND_UP().
+
+#if defined(__AVX512F__)
+
+#include <immintrin.h>
+#define NUM_LANES	8
+typedef __m512d tLanes;
+
+static inline tLanes LanesLoad(const double *p)				{ return _mm512_load_pd(p); }
+static inline tLanes LanesLoadUnaligned(const double *p)	{ return _mm512_loadu_pd(p); }
+static inline void LanesStore(double *p, tLanes a)			{ _mm512_store_pd(p, a); }
+static inline tLanes LanesSet(double x)						{ return _mm512_set1_pd(x); }
+static inline tLanes LanesAdd(tLanes a, tLanes b)			{ return _mm512_add_pd(a, b); }
+static inline tLanes LanesSubtract(tLanes a, tLanes b)		{ return _mm512_sub_pd(a, b); }
+static inline tLanes LanesMultiply(tLanes a, tLanes b)		{ return _mm512_mul_pd(a, b); }
+static inline tLanes LanesDivide(tLanes a, tLanes b)		{ return _mm512_div_pd(a, b); }
+// Masked, so that it doesn't start from _mm512_undefined_pd(), which GCC warns about under -Wall.
+static inline tLanes LanesSqRoot(tLanes a)					{ return _mm512_maskz_sqrt_pd((__mmask8)0xFF, a); }
+// Bit n of the result is set if lane n of a equals lane n of b.
+static inline unsigned int LanesEqual(tLanes a, tLanes b)	{ return _mm512_cmp_pd_mask(a, b, _CMP_EQ_OQ); }
+// Bit n of the result is set if lane n of a is between -Limit and Limit, not including them, which NaN isn't.
+static inline unsigned int LanesWithin(tLanes a, double Limit)	{ return _mm512_cmp_pd_mask(_mm512_abs_pd(a), _mm512_set1_pd(Limit), _CMP_LT_OQ); }
+
+#elif defined(__AVX2__) || defined(__AVX__)
+
+#include <immintrin.h>
+#define NUM_LANES	4
+typedef __m256d tLanes;
+
+static inline tLanes LanesLoad(const double *p)				{ return _mm256_load_pd(p); }
+static inline tLanes LanesLoadUnaligned(const double *p)	{ return _mm256_loadu_pd(p); }
+static inline void LanesStore(double *p, tLanes a)			{ _mm256_store_pd(p, a); }
+static inline tLanes LanesSet(double x)						{ return _mm256_set1_pd(x); }
+static inline tLanes LanesAdd(tLanes a, tLanes b)			{ return _mm256_add_pd(a, b); }
+static inline tLanes LanesSubtract(tLanes a, tLanes b)		{ return _mm256_sub_pd(a, b); }
+static inline tLanes LanesMultiply(tLanes a, tLanes b)		{ return _mm256_mul_pd(a, b); }
+static inline tLanes LanesDivide(tLanes a, tLanes b)		{ return _mm256_div_pd(a, b); }
+static inline tLanes LanesSqRoot(tLanes a)					{ return _mm256_sqrt_pd(a); }
+static inline unsigned int LanesEqual(tLanes a, tLanes b)	{ return _mm256_movemask_pd(_mm256_cmp_pd(a, b, _CMP_EQ_OQ)); }
+static inline unsigned int LanesWithin(tLanes a, double Limit)	{ return _mm256_movemask_pd(_mm256_cmp_pd(_mm256_andnot_pd(_mm256_set1_pd(-0.0), a), _mm256_set1_pd(Limit), _CMP_LT_OQ)); }
+
+#elif defined(_M_X64) || defined(__SSE2__)
+
+#include <emmintrin.h>
+#define NUM_LANES	2
+typedef __m128d tLanes;
+
+static inline tLanes LanesLoad(const double *p)				{ return _mm_load_pd(p); }
+static inline tLanes LanesLoadUnaligned(const double *p)	{ return _mm_loadu_pd(p); }
+static inline void LanesStore(double *p, tLanes a)			{ _mm_store_pd(p, a); }
+static inline tLanes LanesSet(double x)						{ return _mm_set1_pd(x); }
+static inline tLanes LanesAdd(tLanes a, tLanes b)			{ return _mm_add_pd(a, b); }
+static inline tLanes LanesSubtract(tLanes a, tLanes b)		{ return _mm_sub_pd(a, b); }
+static inline tLanes LanesMultiply(tLanes a, tLanes b)		{ return _mm_mul_pd(a, b); }
+static inline tLanes LanesDivide(tLanes a, tLanes b)		{ return _mm_div_pd(a, b); }
+static inline tLanes LanesSqRoot(tLanes a)					{ return _mm_sqrt_pd(a); }
+static inline unsigned int LanesEqual(tLanes a, tLanes b)	{ return _mm_movemask_pd(_mm_cmpeq_pd(a, b)); }
+static inline unsigned int LanesWithin(tLanes a, double Limit)	{ return _mm_movemask_pd(_mm_cmplt_pd(_mm_andnot_pd(_mm_set1_pd(-0.0), a), _mm_set1_pd(Limit))); }
+
+#else
+
+#include <math.h>
+#define NUM_LANES	1
+typedef double tLanes;
+
+static inline tLanes LanesLoad(const double *p)				{ return *p; }
+static inline tLanes LanesLoadUnaligned(const double *p)	{ return *p; }
+static inline void LanesStore(double *p, tLanes a)			{ *p = a; }
+static inline tLanes LanesSet(double x)						{ return x; }
+static inline tLanes LanesAdd(tLanes a, tLanes b)			{ return a + b; }
+static inline tLanes LanesSubtract(tLanes a, tLanes b)		{ return a - b; }
+static inline tLanes LanesMultiply(tLanes a, tLanes b)		{ return a * b; }
+static inline tLanes LanesDivide(tLanes a, tLanes b)		{ return a / b; }
+static inline tLanes LanesSqRoot(tLanes a)					{ return sqrt(a); }
+static inline unsigned int LanesEqual(tLanes a, tLanes b)	{ return a == b; }
+static inline unsigned int LanesWithin(tLanes a, double Limit)	{ return fabs(a) < Limit; }
+
+#endif
+
+#define LANES_ALIGNMENT		64	// Enough for the widest lanes, and a cache line.
+#define ALL_LANES			((1u << NUM_LANES) - 1)
+#define LANES_ROUND_UP(n)	(((n) + NUM_LANES - 1) / NUM_LANES * NUM_LANES)
+
+// Bit n of the result is set if lane n of a is a proper number, i.e. not infinity or NaN.
+static inline unsigned int LanesFinite(tLanes a)			{ return LanesEqual(LanesSubtract(a, a), LanesSet(0)); }
+
+// The lowest lane which is set in Lanes, which mustn't be 0.
+static inline int LowestLane(unsigned int Lanes)
+{
+	int Lane;
+
+	for (Lane = 0; (Lanes & (1u << Lane)) == 0; Lane++)
+		;
+	return Lane;
+}
@@ -0,0 +1,153 @@
+#include "stdafx.h"
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#include "MappedFile.h"
+
+#ifdef _WIN32
+bool OpenMappedFile(const char *FileName, bool Writable, sMappedFile *pFile)
+{
+	HANDLE File;
+
+	// Not sharing it with writers is what keeps a second process out.
+	if (Writable)
+		File = CreateFileA(FileName, GENERIC_READ | GENERIC_WRITE, 0, nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+	else
+		File = CreateFileA(FileName, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (File == INVALID_HANDLE_VALUE)
+		return false;
+	pFile->File = (intptr_t)File;
+	pFile->Mapping = 0;
+	pFile->Writable = Writable;
+	pFile->Size = 0;
+	pFile->pData = nullptr;
+	return true;
+}
+
+bool MappedFileLength(const sMappedFile *pFile, unsigned long long *pLength)
+{
+	LARGE_INTEGER Length;
+
+	if (!GetFileSizeEx((HANDLE)pFile->File, &Length))
+		return false;
+	*pLength = Length.QuadPart;
+	return true;
+}
+
+bool MapFile(sMappedFile *pFile, size_t Size)
+{
+	HANDLE Mapping;
+
+	// A writable mapping bigger than the file makes the file that big.
+	Mapping = CreateFileMappingA((HANDLE)pFile->File, nullptr, pFile->Writable ? PAGE_READWRITE : PAGE_READONLY,
+								 (DWORD)((unsigned long long)Size >> 32), (DWORD)Size, nullptr);
+	if (Mapping == nullptr)
+		return false;
+	pFile->pData = MapViewOfFile(Mapping, pFile->Writable ? FILE_MAP_ALL_ACCESS : FILE_MAP_READ, 0, 0, Size);
+	if (pFile->pData == nullptr)
+	{
+		CloseHandle(Mapping);
+		return false;
+	}
+	pFile->Mapping = (intptr_t)Mapping;
+	pFile->Size = Size;
+	return true;
+}
+
+void UnmapFile(sMappedFile *pFile)
+{
+	if (pFile->pData == nullptr)
+		return;
+	if (pFile->Writable)
+		FlushViewOfFile(pFile->pData, 0);
+	UnmapViewOfFile(pFile->pData);
+	CloseHandle((HANDLE)pFile->Mapping);
+	pFile->pData = nullptr;
+}
+
+bool EmptyMappedFile(sMappedFile *pFile)
+{
+	LARGE_INTEGER Start;
+
+	Start.QuadPart = 0;
+	return SetFilePointerEx((HANDLE)pFile->File, Start, nullptr, FILE_BEGIN) && SetEndOfFile((HANDLE)pFile->File);
+}
+
+void CloseMappedFile(sMappedFile *pFile)
+{
+	UnmapFile(pFile);
+	CloseHandle((HANDLE)pFile->File);
+}
+#else
+bool OpenMappedFile(const char *FileName, bool Writable, sMappedFile *pFile)
+{
+	int File = Writable ? open(FileName, O_RDWR | O_CREAT, 0644) : open(FileName, O_RDONLY);
+
+	if (File < 0)
+		return false;
+	if (Writable && flock(File, LOCK_EX | LOCK_NB) != 0)
+	{
+		close(File);
+		return false;
+	}
+	pFile->File = File;
+	pFile->Mapping = 0;
+	pFile->Writable = Writable;
+	pFile->Size = 0;
+	pFile->pData = nullptr;
+	return true;
+}
+
+bool MappedFileLength(const sMappedFile *pFile, unsigned long long *pLength)
+{
+	struct stat Stat;
+
+	if (fstat((int)pFile->File, &Stat) != 0)
+		return false;
+	*pLength = Stat.st_size;
+	return true;
+}
+
+bool MapFile(sMappedFile *pFile, size_t Size)
+{
+	unsigned long long Length;
+	void *p;
+
+	// Unlike Windows, touching a mapped page past the end of the file is an error rather than making it longer.
+	if (pFile->Writable && (!MappedFileLength(pFile, &Length) || (Length < Size && ftruncate((int)pFile->File, Size) != 0)))
+		return false;
+	p = mmap(nullptr, Size, pFile->Writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, (int)pFile->File, 0);
+	if (p == MAP_FAILED)
+		return false;
+	pFile->pData = p;
+	pFile->Size = Size;
+	return true;
+}
+
+void UnmapFile(sMappedFile *pFile)
+{
+	if (pFile->pData == nullptr)
+		return;
+	if (pFile->Writable)
+		msync(pFile->pData, pFile->Size, MS_SYNC);
+	munmap(pFile->pData, pFile->Size);
+	pFile->pData = nullptr;
+}
+
+bool EmptyMappedFile(sMappedFile *pFile)
+{
+	return ftruncate((int)pFile->File, 0) == 0;
+}
+
+void CloseMappedFile(sMappedFile *pFile)
+{
+	UnmapFile(pFile);
+	close((int)pFile->File);
+}
+#endif
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// A file which we look at through memory rather than by reading it, so it doesn't matter how big it is, and only the
+// parts we touch get loaded. Used for the files we keep between runs (ResultCache.h and FormulaLibrary.h).
+typedef struct {
+	intptr_t	File;		// The OS's handles for the file and, on Windows, the mapping.
+	intptr_t	Mapping;
+	bool		Writable;
+	size_t		Size;		// How much of it is mapped.
+	void		*pData;		// Where it's mapped, or nullptr if it isn't.
+} sMappedFile;
+
+// Opens the file, without mapping any of it yet. If Writable, it's created if it doesn't exist, and nobody else can open it
+// for writing until we've closed it, so this fails if someone already has.
+bool OpenMappedFile(const char *FileName, bool Writable, sMappedFile *pFile);
+
+bool MappedFileLength(const sMappedFile *pFile, unsigned long long *pLength);
+
+// Maps the first Size bytes. If the file is Writable and shorter than that, it's made longer, the new bytes being zeros.
+bool MapFile(sMappedFile *pFile, size_t Size);
+
+void UnmapFile(sMappedFile *pFile);
+
+// Throws away everything in a Writable file. It mustn't be mapped.
+bool EmptyMappedFile(sMappedFile *pFile);
+
+// Unmaps it, if need be, and closes it. Anything written to it is saved.
+void CloseMappedFile(sMappedFile *pFile);
@@ -0,0 +1,84 @@
+#include "stdafx.h"
+#include <math.h>
+#include <string.h>
+#include <vector>
+#include "MeetInTheMiddle.h"
+using namespace std;
+
+static unsigned long long HashValues(const double Values[], int FirstPos, int EndPos)
+{
+	unsigned long long Hash = 0, Bits;
+	double Value;
+	int Pos;
+
+	for (Pos = FirstPos; Pos < EndPos; Pos++)
+	{
+		// -0 and 0 have different bits but are the same number.
+		Value = Values[Pos] + 0.0;
+		memcpy(&Bits, &Value, sizeof(Bits));
+		Hash = (Hash ^ Bits) * 0x9E3779B97F4A7C15ull;
+		Hash ^= Hash >> 29;
+	}
+	return Hash;
+}
+
+void BuildValueIndex(sValueIndex *pIndex, const sExpressionTable *pTable, int FirstPos, int EndPos)
+{
+	size_t NumSlots;
+	int Mask, Slot, e;
+
+	pIndex->FirstPos = FirstPos;
+	pIndex->EndPos = EndPos;
+	// No more than half full.
+	for (NumSlots = 1024; NumSlots < 2 * pTable->Expressions.size(); NumSlots *= 2)
+		;
+	pIndex->Slots.assign(NumSlots, -1);
+	Mask = (int)NumSlots - 1;
+	for (e = 0; e < (int)pTable->Expressions.size(); e++)
+	{
+		for (Slot = (int)(HashValues(ExpressionValues(pTable, e), FirstPos, EndPos) & Mask); pIndex->Slots[Slot] >= 0; Slot = (Slot + 1) & Mask)
+			;
+		pIndex->Slots[Slot] = e;
+	}
+}
+
+int NextMatch(const sValueIndex *pIndex, const sExpressionTable *pTable, const double Values[], int *pSlot)
+{
+	const double *pOther;
+	int Mask = (int)pIndex->Slots.size() - 1;
+	int e, Pos;
+
+	*pSlot = *pSlot < 0 ? (int)(HashValues(Values, pIndex->FirstPos, pIndex->EndPos) & Mask) : (*pSlot + 1) & Mask;
+	for (; (e = pIndex->Slots[*pSlot]) >= 0; *pSlot = (*pSlot + 1) & Mask)
+	{
+		pOther = ExpressionValues(pTable, e);
+		for (Pos = pIndex->FirstPos; Pos < pIndex->EndPos && pOther[Pos] == Values[Pos]; Pos++)
+			;
+		if (Pos == pIndex->EndPos)
+			return e;
+	}
+	return -1;
+}
+
+bool WantedRightValues(eOperatorKind Kind, const double Left[], const sSearchLimits *pLimits, int FirstPos, double Wanted[])
+{
+	const double *pSeq = &pLimits->SeqLanes[NUM_POSITIONS];
+	int Pos;
+
+	for (Pos = FirstPos / NUM_LANES * NUM_LANES; Pos < pLimits->SeqLen; Pos += NUM_LANES)
+	{
+		// "left right op" is the sequence when right is "left sequence op" for - and /, or "sequence left inverse" for the
+		// ones which don't care about order.
+		if (OperatorAlgebra[Kind].Commutative)
+			LanesStore(&Wanted[Pos], ApplyAnyOperator(OperatorAlgebra[Kind].Inverse, LanesLoad(&pSeq[Pos]), LanesLoadUnaligned(&Left[Pos])));
+		else
+			LanesStore(&Wanted[Pos], ApplyAnyOperator(Kind, LanesLoadUnaligned(&Left[Pos]), LanesLoad(&pSeq[Pos])));
+	}
+	// A right which gave infinity or nonsense wouldn't have been kept.
+	for (Pos = FirstPos; Pos < pLimits->SeqLen; Pos++)
+	{
+		if (!isfinite(Wanted[Pos]))
+			return false;
+	}
+	return true;
+}
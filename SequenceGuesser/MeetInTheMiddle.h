@@ -0,0 +1,110 @@
+#pragma once
+
+#include <algorithm>
+#include <vector>
+#include "BottomUp.h"
+#include "Lanes.h"
+#include "Operators.h"
+#include "SearchLimits.h"
+#include "Solver.h"
+
+// The search for formulae too long for the others to get through. Most long formulae are "left right op" for some binary
+// operator which can be undone (+, -, * or /), and given left and the sequence, there's only one set of values right could
+// have: the sequence minus left for +, and so on. So rather than trying every left with every right, we build up every
+// expression of up to half the length the way the bottom-up search does, file them by their values, and for each one as
+// left, work out what right would have to be and look it up. That's a few million look-ups where trying them all would be
+// trillions of formulae.
+// It only finds formulae made like that, from halves of up to MEET_MAX_HALF_ITEMS items (or fewer, if that would be longer
+// than the attempt allows), and like the bottom-up search it needs memory for every half it keeps, so it's bounded, and if
+// it fills up the search only goes through the halves it kept. The halves are worked out with doubles, so a formula whose
+// halves don't come out whole at every position (e.g. i/3 + 2i/3) can be missed, since taking one from the sequence doesn't
+// always give exactly the other.
+
+#define MEET_MAX_HALF_ITEMS	7	// Building the halves of 8 items takes minutes, and there are too many to keep.
+
+// The expressions in an sExpressionTable, filed by their values at positions FirstPos..EndPos-1, which are the positions
+// no expression can have as a seed. Several expressions can have the same values there.
+typedef struct {
+	std::vector<int>	Slots;	// Open addressing. Each slot holds an expression number or -1. Size is a power of 2.
+	int					FirstPos, EndPos;
+} sValueIndex;
+
+void BuildValueIndex(sValueIndex *pIndex, const sExpressionTable *pTable, int FirstPos, int EndPos);
+
+// Goes through the expressions with the values Values[pIndex->FirstPos..EndPos-1]. Start with *pSlot at -1, and each call
+// returns the next one, or -1 when there are no more.
+int NextMatch(const sValueIndex *pIndex, const sExpressionTable *pTable, const double Values[], int *pSlot);
+
+// The values right needs to have for "left right Kind" to give the sequence, worked out into Wanted[], given left's. Returns
+// false if there aren't any, e.g. because left is 0 somewhere and Kind is *.
+bool WantedRightValues(eOperatorKind Kind, const double Left[], const sSearchLimits *pLimits, int FirstPos, double Wanted[]);
+
+// Searches for a formula which fits the sequence, using the operators in tOps and up to pLimits->MaxItemsInExpression
+// items, by putting halves together as described above. Of the formulae made like that, it finds one of the shortest.
+template <class tOps>
+static eBottomUpResult MeetInTheMiddleSearch(const sSearchLimits *pLimits, size_t MaxBytes, sFormula *pFound)
+{
+	sExpressionTable Table;
+	sValueIndex Index;
+	sExpression Join;
+	alignas(LANES_ALIGNMENT) double Wanted[NUM_POSITIONS];
+	int FirstOfSize[MAX_POSS_ITEMS_IN_EXPRESSION + 2];
+	int MaxHalfItems, NumItems, LeftItems, RightItems, Op, l, r, Slot;
+	eOperatorKind Kind;
+	eBottomUpResult Result;
+
+	MaxHalfItems = std::min(MEET_MAX_HALF_ITEMS, (pLimits->MaxItemsInExpression - 1) / 2);
+	InitExpressionTable(&Table, pLimits->SeqLen, MaxBytes);
+	// The halves get checked on their own as they're built, like in the bottom-up search.
+	if ((Result = BuildExpressions<tOps>(&Table, FirstOfSize, MaxHalfItems, MaxHalfItems, pLimits, pFound)) != BOTTOM_UP_NOT_FOUND)
+		return Result;
+	BuildValueIndex(&Index, &Table, pLimits->NumIndexValsForItem[S], pLimits->SeqLen);
+
+	pFound->Operators = tOps::Operators;
+	Join.Item.ItemType = OPERATOR;
+	for (NumItems = 3; NumItems <= 2 * MaxHalfItems + 1; NumItems++)
+	{
+		// Don't bother going through the lefts if no formula this long can be new.
+		if (!FormulaIsNew(NOVEL_S | NOVEL_OPERATOR, NumItems, pLimits))
+			continue;
+		Join.NumItems = NumItems;
+		for (Op = 0; Op < tOps::NumOperators; Op++)
+		{
+			Kind = tOps::KindOf[Op];
+			if (tOps::NumOperandsOf[Op] != 2 || OperatorAlgebra[Kind].Inverse == NUM_OPERATOR_KINDS)
+				continue;
+			Join.Item.Index = Op;
+			for (LeftItems = std::max(1, NumItems - 1 - MaxHalfItems); LeftItems <= MaxHalfItems && LeftItems < NumItems - 1; LeftItems++)
+			{
+				// a+b and b+a give the same values so only look for one of them.
+				RightItems = NumItems - 1 - LeftItems;
+				if (OperatorAlgebra[Kind].Commutative && LeftItems > RightItems)
+					break;
+				for (l = FirstOfSize[LeftItems]; l < FirstOfSize[LeftItems + 1]; l++)
+				{
+					if ((l & 0xFFF) == 0 && SearchStopped(pLimits->pWatch))
+						return BOTTOM_UP_STOPPED;
+					if (!WantedRightValues(Kind, ExpressionValues(&Table, l), pLimits, Index.FirstPos, Wanted))
+						continue;
+					Join.Left = l;
+					for (Slot = -1; (r = NextMatch(&Index, &Table, Wanted, &Slot)) >= 0; )
+					{
+						if (Table.Expressions[r].NumItems != RightItems)
+							continue;
+						Join.Right = r;
+						Join.FirstPos = std::max(Table.Expressions[l].FirstPos, Table.Expressions[r].FirstPos);
+						Join.Novelty = Table.Expressions[l].Novelty | Table.Expressions[r].Novelty | ItemNovelty(&Join.Item, pLimits);
+						if (!FormulaIsNew(Join.Novelty, NumItems, pLimits))
+							continue;
+						// It fits at the positions every expression has a value at, but it might need fewer seeds than that,
+						// so check the rest too, and exactly.
+						ExpressionToFormula(&Table, &Join, pFound);
+						if (FormulaGeneratesSequence(pFound, pLimits->pSeq, pLimits->SeqLen))
+							return BOTTOM_UP_FOUND;
+					}
+				}
+			}
+		}
+	}
+	return Table.Full ? BOTTOM_UP_INCOMPLETE : BOTTOM_UP_NOT_FOUND;
+}
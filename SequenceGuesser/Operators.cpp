@@ -0,0 +1,5 @@
+#include "stdafx.h"
+#include "Operators.h"
+
+// The one copy of the table (see sOperatorTable).
+constexpr sOperator sOperatorTable::ByKind[NUM_OPERATOR_KINDS];
@@ -0,0 +1,281 @@
+#pragma once
+
+#include <limits.h>
+#include <math.h>
+#include "Lanes.h"
+#include "Solver.h"
+
+// Every operator we know about. Don't change the order, since sOperatorTable::ByKind[] is indexed by it.
+typedef enum {
+	ADD_OP, SUBTRACT_OP, MULTIPLY_OP, DIVIDE_OP, SQUARE_OP, CUBE_OP, SQROOT_OP, DIGIT_FROM_RIGHT_OP, DIGIT_FROM_LEFT_OP,
+	SUM_OP, PRODUCT_OP, MODULO_OP,
+	NUM_OPERATOR_KINDS
+} eOperatorKind;
+
+// A struct only so that the table is defined once for the whole program (in Operators.cpp), rather than once in each
+// file, since tOperatorSet::Operators[] point into it and OperatorKindOf() goes by those addresses.
+struct sOperatorTable {
+	static constexpr sOperator ByKind[NUM_OPERATOR_KINDS] = {
+		{ "+", 2 },
+		{ "-", 2 },
+		{ "*", 2 },
+		{ "/", 2 },
+		{ "^2", 1 },
+		{ "^3", 1 },
+		{ "sqrt", 1 },
+		{ "rdigit", 2 },
+		{ "ldigit", 2 },
+		{ "sum", 1 },	// Sigma: "S(i-1) sum" is S(0) + S(1) + ... + S(i-1), and "i sum" is 0 + 1 + ... + i.
+		{ "prod", 1 },	// Pi: "S(i-1) prod" is S(0) * S(1) * ... * S(i-1), and "i prod" is 1 * 2 * ... * i, i.e. i!.
+		{ "%", 2 },
+	};
+};
+
+// What the depth first search's pruning rules know about each operator (see tPruneTable in Solver.cpp). The rules only go
+// by this, so a new operator gets pruned properly as long as its line here is right. NUM_OPERATOR_KINDS means none.
+typedef struct {
+	bool			Commutative;			// "a b op" is "b a op".
+	bool			Associative;			// "a b op c op" is "a b c op op". With Inverse, "a b op c inv" is "a b c inv op" and so on.
+	eOperatorKind	Inverse;				// Undoes it, so "a x op x inv" (or "x op inv" for a unary one) is "a" (or "x").
+	eOperatorKind	SameOperandsAs;			// "x x op" is "x 2 SameOperandsAs" for a binary one, or "x SameOperandsAs" for a unary one.
+	bool			SameOperandsConstant;	// "x x op" is the same whatever x is.
+	bool			FoldsConstants;			// "2 3 op" is worth no more than a constant, since it's usually a small one.
+	bool			Power;					// x to some power. These don't care which order they come in: "x ^2 ^3" is "x ^3 ^2".
+	bool			Aggregate;				// Adds or multiplies up an S(i-k) or i from the start of the sequence, so it can only go straight after one.
+	bool			OneDoesNothing;			// "x 1 op" is "x" (and so is "1 x op" if it's commutative), or for a unary one "1 op" is "1".
+} sOperatorAlgebra;
+
+constexpr sOperatorAlgebra OperatorAlgebra[NUM_OPERATOR_KINDS] = {
+	// Commutative	Associative	Inverse				SameOperandsAs		SameOperandsConstant	FoldsConstants	Power	Aggregate	OneDoesNothing
+	{ true,			true,		SUBTRACT_OP,		MULTIPLY_OP,		false,					true,			false,	false,		false },	// +
+	{ false,		false,		ADD_OP,				NUM_OPERATOR_KINDS,	true,					true,			false,	false,		false },	// -
+	{ true,			true,		DIVIDE_OP,			SQUARE_OP,			false,					true,			false,	false,		true },		// *
+	{ false,		false,		MULTIPLY_OP,		NUM_OPERATOR_KINDS,	true,					false,			false,	false,		true },		// /
+	{ false,		false,		SQROOT_OP,			NUM_OPERATOR_KINDS,	false,					false,			true,	false,		true },		// ^2
+	{ false,		false,		NUM_OPERATOR_KINDS,	NUM_OPERATOR_KINDS,	false,					false,			true,	false,		true },		// ^3
+	{ false,		false,		SQUARE_OP,			NUM_OPERATOR_KINDS,	false,					false,			true,	false,		true },		// sqrt
+	{ false,		false,		NUM_OPERATOR_KINDS,	NUM_OPERATOR_KINDS,	false,					true,			false,	false,		false },	// rdigit
+	{ false,		false,		NUM_OPERATOR_KINDS,	NUM_OPERATOR_KINDS,	false,					true,			false,	false,		false },	// ldigit
+	{ false,		false,		NUM_OPERATOR_KINDS,	NUM_OPERATOR_KINDS,	false,					false,			false,	true,		false },	// sum
+	{ false,		false,		NUM_OPERATOR_KINDS,	NUM_OPERATOR_KINDS,	false,					false,			false,	true,		false },	// prod
+	{ false,		false,		NUM_OPERATOR_KINDS,	NUM_OPERATOR_KINDS,	true,					true,			false,	false,		false },	// %
+};
+
+// The operator which goes with Kind like + and - go together. "a b op1 c op2" is "a b c op op" for some ops in the same group.
+constexpr eOperatorKind AssociativeGroupOf(eOperatorKind Kind)
+{
+	return OperatorAlgebra[Kind].Associative ? Kind
+		 : OperatorAlgebra[Kind].Inverse != NUM_OPERATOR_KINDS && OperatorAlgebra[OperatorAlgebra[Kind].Inverse].Associative ? OperatorAlgebra[Kind].Inverse
+		 : NUM_OPERATOR_KINDS;
+}
+
+static inline double DigitFromRightOpFn(double a, double b)	{ return int(a / pow(10, b)) % 10; }				// Digit 0 is units, 1 is tens, 2 is hundreds etc.
+static inline double DigitFromLeftOpFn(double a, double b)	{ return DigitFromRightOpFn(a, log10(a) - b); }	// Digit 0 is leftmost digit, 1 is next etc.
+
+// Applies a scalar operator function to each lane in turn, for operators with no vector instructions.
+static inline tLanes EachLane(double (*pOpFunction)(double a, double b), tLanes a, tLanes b)
+{
+	alignas(LANES_ALIGNMENT) double A[NUM_LANES], B[NUM_LANES];
+	int n;
+
+	LanesStore(A, a);
+	LanesStore(B, b);
+	for (n = 0; n < NUM_LANES; n++)
+		A[n] = pOpFunction(A[n], B[n]);
+	return LanesLoad(A);
+}
+
+// What each operator does. a is the operand below the top of the stack and b the top one, which is the only one the unary
+// operators look at.
+template <eOperatorKind Kind> struct tOperator;
+template <> struct tOperator<ADD_OP>				{ static inline tLanes Apply(tLanes a, tLanes b) { return LanesAdd(a, b); } };
+template <> struct tOperator<SUBTRACT_OP>			{ static inline tLanes Apply(tLanes a, tLanes b) { return LanesSubtract(a, b); } };
+template <> struct tOperator<MULTIPLY_OP>			{ static inline tLanes Apply(tLanes a, tLanes b) { return LanesMultiply(a, b); } };
+template <> struct tOperator<DIVIDE_OP>				{ static inline tLanes Apply(tLanes a, tLanes b) { return LanesDivide(a, b); } };
+template <> struct tOperator<SQUARE_OP>				{ static inline tLanes Apply(tLanes, tLanes b) { return LanesMultiply(b, b); } };
+template <> struct tOperator<CUBE_OP>				{ static inline tLanes Apply(tLanes, tLanes b) { return LanesMultiply(LanesMultiply(b, b), b); } };
+template <> struct tOperator<SQROOT_OP>				{ static inline tLanes Apply(tLanes, tLanes b) { return LanesSqRoot(b); } };
+template <> struct tOperator<DIGIT_FROM_RIGHT_OP>	{ static inline tLanes Apply(tLanes a, tLanes b) { return EachLane(DigitFromRightOpFn, a, b); } };
+template <> struct tOperator<DIGIT_FROM_LEFT_OP>	{ static inline tLanes Apply(tLanes a, tLanes b) { return EachLane(DigitFromLeftOpFn, a, b); } };
+// The aggregates need the item they go after, not its values, so whatever applies them has to look them up (see
+// AggregateLanesAt()). If something forgets to, it gets nonsense rather than a wrong answer.
+template <> struct tOperator<SUM_OP>				{ static inline tLanes Apply(tLanes, tLanes) { return LanesSet(NAN); } };
+template <> struct tOperator<PRODUCT_OP>			{ static inline tLanes Apply(tLanes, tLanes) { return LanesSet(NAN); } };
+template <> struct tOperator<MODULO_OP>				{ static inline tLanes Apply(tLanes a, tLanes b) { return EachLane(fmod, a, b); } };
+
+constexpr bool AnyOf(void) { return false; }
+template <typename... tRest> constexpr bool AnyOf(bool First, tRest... Rest) { return First || AnyOf(Rest...); }
+
+// Picks operator number Index out of the list and applies it. Each operator is inlined, so this is a few compares rather
+// than a call through a function pointer.
+template <eOperatorKind First, eOperatorKind... Rest>
+struct tOperatorSwitch {
+	static inline tLanes Apply(int Index, tLanes a, tLanes b)
+	{
+		return Index == 0 ? tOperator<First>::Apply(a, b) : tOperatorSwitch<Rest...>::Apply(Index - 1, a, b);
+	}
+};
+template <eOperatorKind Last>
+struct tOperatorSwitch<Last> {
+	static inline tLanes Apply(int, tLanes a, tLanes b)	{ return tOperator<Last>::Apply(a, b); }
+};
+
+// Applies any operator, picked at run time. It's slower than going through a tOperatorSet, so it's only for building the
+// formula library (see FormulaLibrary.h).
+static inline tLanes ApplyAnyOperator(eOperatorKind Kind, tLanes a, tLanes b)
+{
+	// All of them, in eOperatorKind order, so that the index is the kind.
+	return tOperatorSwitch<ADD_OP, SUBTRACT_OP, MULTIPLY_OP, DIVIDE_OP, SQUARE_OP, CUBE_OP, SQROOT_OP,
+						   DIGIT_FROM_RIGHT_OP, DIGIT_FROM_LEFT_OP, SUM_OP, PRODUCT_OP, MODULO_OP>::Apply(Kind, a, b);
+}
+
+// Whole numbers for checking formulae exactly. 128 bits where the compiler has them, so the values on the way to an answer
+// can go well past anything a sequence of ints needs, otherwise 64.
+#ifdef __SIZEOF_INT128__
+typedef __int128 tExactInt;
+#else
+typedef long long tExactInt;
+#endif
+
+// Arithmetic which says so, rather than giving the wrong answer, when the result doesn't fit.
+#if defined(__GNUC__) || defined(__clang__)
+static inline bool AddExactly(tExactInt a, tExactInt b, tExactInt *pResult)			{ return !__builtin_add_overflow(a, b, pResult); }
+static inline bool SubtractExactly(tExactInt a, tExactInt b, tExactInt *pResult)	{ return !__builtin_sub_overflow(a, b, pResult); }
+static inline bool MultiplyExactly(tExactInt a, tExactInt b, tExactInt *pResult)	{ return !__builtin_mul_overflow(a, b, pResult); }
+#else
+static inline bool AddExactly(tExactInt a, tExactInt b, tExactInt *pResult)
+{
+	if ((b > 0 && a > LLONG_MAX - b) || (b < 0 && a < LLONG_MIN - b))
+		return false;
+	*pResult = a + b;
+	return true;
+}
+
+static inline bool SubtractExactly(tExactInt a, tExactInt b, tExactInt *pResult)
+{
+	if ((b < 0 && a > LLONG_MAX + b) || (b > 0 && a < LLONG_MIN + b))
+		return false;
+	*pResult = a - b;
+	return true;
+}
+
+static inline bool MultiplyExactly(tExactInt a, tExactInt b, tExactInt *pResult)
+{
+	unsigned long long MagA = a < 0 ? 0ull - (unsigned long long)a : (unsigned long long)a;
+	unsigned long long MagB = b < 0 ? 0ull - (unsigned long long)b : (unsigned long long)b;
+	unsigned long long Limit = (a < 0) != (b < 0) ? (unsigned long long)LLONG_MAX + 1 : (unsigned long long)LLONG_MAX;
+
+	if (MagA != 0 && MagB > Limit / MagA)
+		return false;
+	*pResult = (a < 0) != (b < 0) ? (tExactInt)(0ull - MagA * MagB) : (tExactInt)(MagA * MagB);
+	return true;
+}
+#endif
+
+// Digit Digit of a, counting from the right (0 being the units), which is negative if a is, like DigitFromRightOpFn().
+static inline tExactInt DigitFromRightExactly(tExactInt a, tExactInt Digit)
+{
+	if (Digit < 0)
+		return 0;
+	for (; Digit > 0 && a != 0; Digit--)
+		a /= 10;
+	return a % 10;
+}
+
+// Applies any operator, picked at run time, to whole numbers. Returns false if the answer isn't a whole number (e.g. 7 / 2
+// or the square root of 5), or doesn't fit, since then a formula which uses it can't be trusted to give the user's numbers.
+// The aggregates need more than the value on the stack, so they aren't here.
+static inline bool ApplyOperatorExactly(eOperatorKind Kind, tExactInt a, tExactInt b, tExactInt *pResult)
+{
+	tExactInt Root, Scale;
+	int NumDigits;
+
+	switch (Kind)
+	{
+	case ADD_OP:
+		return AddExactly(a, b, pResult);
+	case SUBTRACT_OP:
+		return SubtractExactly(a, b, pResult);
+	case MULTIPLY_OP:
+		return MultiplyExactly(a, b, pResult);
+	case DIVIDE_OP:
+		// Dividing by -1 is the one way division can overflow.
+		if (b == -1)
+			return SubtractExactly(0, a, pResult);
+		if (b == 0 || a % b != 0)
+			return false;
+		*pResult = a / b;
+		return true;
+	case SQUARE_OP:
+		return MultiplyExactly(b, b, pResult);
+	case CUBE_OP:
+		return MultiplyExactly(b, b, &Root) && MultiplyExactly(Root, b, pResult);
+	case SQROOT_OP:
+		if (b < 0)
+			return false;
+		// Double gets close, then make sure of it.
+		for (Root = (tExactInt)sqrt((double)b); Root > 0 && (!MultiplyExactly(Root, Root, &Scale) || Scale > b); Root--)
+			;
+		for (; MultiplyExactly(Root + 1, Root + 1, &Scale) && Scale <= b; Root++)
+			;
+		if (Root * Root != b)
+			return false;
+		*pResult = Root;
+		return true;
+	case DIGIT_FROM_RIGHT_OP:
+		*pResult = DigitFromRightExactly(a, b);
+		return true;
+	case DIGIT_FROM_LEFT_OP:
+		if (a <= 0 || b < 0)
+			return false;
+		for (NumDigits = 1, Scale = a; Scale >= 10; Scale /= 10)
+			NumDigits++;
+		*pResult = DigitFromRightExactly(a, NumDigits - 1 - b);
+		return b < NumDigits;
+	case MODULO_OP:
+		// Same sign as a, like fmod().
+		if (b == 0)
+			return false;
+		*pResult = b == -1 ? 0 : a % b;
+		return true;
+	default:
+		return false;
+	}
+}
+
+// Which operator an sOperator is, or NUM_OPERATOR_KINDS if it isn't one of sOperatorTable::ByKind[].
+static inline eOperatorKind OperatorKindOf(const sOperator *pOperator)
+{
+	int Kind;
+
+	for (Kind = 0; Kind < NUM_OPERATOR_KINDS && pOperator != &sOperatorTable::ByKind[Kind]; Kind++)
+		;
+	return (eOperatorKind)Kind;
+}
+
+// The operators one of the attempts uses, as a type, so that the search can be compiled separately for each attempt with
+// its operators inlined. An OPERATOR item's Index is its position in the list.
+template <eOperatorKind... Kinds>
+struct tOperatorSet {
+	static const int NumOperators = sizeof...(Kinds);
+	static constexpr eOperatorKind KindOf[sizeof...(Kinds)] = { Kinds... };
+	static constexpr int NumOperandsOf[sizeof...(Kinds)] = { sOperatorTable::ByKind[Kinds].NumOperands... };
+	static constexpr bool HasUnary = AnyOf((sOperatorTable::ByKind[Kinds].NumOperands == 1)...);
+	static constexpr bool HasAggregate = AnyOf(OperatorAlgebra[Kinds].Aggregate...);
+	static const sOperator* const Operators[sizeof...(Kinds)];	// For showing the formula to the user.
+
+	// Whether Kind is one of the operators. This is known at compile time, so the pruning rules for operators which aren't
+	// in the set disappear.
+	static constexpr bool Has(eOperatorKind Kind)	{ return AnyOf((Kinds == Kind)...); }
+
+	// Whether operator number Index is Kind. Index may be out of range, in which case it isn't.
+	static inline bool Is(int Index, eOperatorKind Kind)	{ return Has(Kind) && Index < NumOperators && KindOf[Index] == Kind; }
+
+	static inline tLanes Apply(int Index, tLanes a, tLanes b)	{ return tOperatorSwitch<Kinds...>::Apply(Index, a, b); }
+};
+
+template <eOperatorKind... Kinds> constexpr eOperatorKind tOperatorSet<Kinds...>::KindOf[];
+template <eOperatorKind... Kinds> constexpr int tOperatorSet<Kinds...>::NumOperandsOf[];
+template <eOperatorKind... Kinds> constexpr bool tOperatorSet<Kinds...>::HasUnary;
+template <eOperatorKind... Kinds> constexpr bool tOperatorSet<Kinds...>::HasAggregate;
+template <eOperatorKind... Kinds> const sOperator* const tOperatorSet<Kinds...>::Operators[] = { &sOperatorTable::ByKind[Kinds]... };
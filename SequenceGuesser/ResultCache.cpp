@@ -0,0 +1,225 @@
+#include "stdafx.h"
+#include <string.h>
+#include <chrono>
+#include <mutex>
+#include "ResultCache.h"
+#include "Solver.h"
+using namespace std;
+
+#define CACHE_MAGIC		0x43524753	// "SGRC" when you look at the file.
+#define CACHE_VERSION	4
+
+bool OpenResultCache(const char *FileName, sResultCache *pCache)
+{
+	sCacheHeader Header;
+	unsigned long long Length;
+	bool Valid;
+
+	if (!OpenMappedFile(FileName, true, &pCache->File))
+		return false;
+	Valid = MappedFileLength(&pCache->File, &Length) && Length >= sizeof(Header) && MapFile(&pCache->File, sizeof(Header));
+	if (Valid)
+	{
+		Header = *(const sCacheHeader *)pCache->File.pData;
+		UnmapFile(&pCache->File);
+		Valid = Header.Magic == CACHE_MAGIC
+			 && Header.Version == CACHE_VERSION
+			 && Header.RecordSize == sizeof(sCacheRecord)
+			 && Header.Fingerprint == AttemptsFingerprint()
+			 && Header.NumRecords > 0 && (Header.NumRecords & (Header.NumRecords - 1)) == 0
+			 && Length >= sizeof(sCacheHeader) + (unsigned long long)Header.NumRecords * sizeof(sCacheRecord);
+	}
+	if (!Valid)
+	{
+		// Start again with an empty cache. Mapping it will fill it with zeros, i.e. empty records.
+		Header.Magic = CACHE_MAGIC;
+		Header.RecordSize = sizeof(sCacheRecord);
+		Header.Fingerprint = AttemptsFingerprint();
+		Header.NumRecords = CACHE_NUM_RECORDS;
+		Header.Version = CACHE_VERSION;
+		if (!EmptyMappedFile(&pCache->File))
+		{
+			CloseMappedFile(&pCache->File);
+			return false;
+		}
+	}
+	if (!MapFile(&pCache->File, sizeof(sCacheHeader) + (size_t)Header.NumRecords * sizeof(sCacheRecord)))
+	{
+		CloseMappedFile(&pCache->File);
+		return false;
+	}
+	pCache->pHeader = (sCacheHeader *)pCache->File.pData;
+	if (!Valid)
+		*pCache->pHeader = Header;
+	pCache->Records = (sCacheRecord *)(pCache->pHeader + 1);
+	return true;
+}
+
+void CloseResultCache(sResultCache *pCache)
+{
+	CloseMappedFile(&pCache->File);
+}
+
+// The solver's engine and whether it solves for closed forms go in too, since they can change the answer.
+static uint64_t SequenceHash(const int Seq[], int SeqLen, const sSolver *pSolver)
+{
+	uint64_t Hash = pSolver->Engine * 2 + pSolver->ClosedForms;
+	int n;
+
+	for (n = 0; n < SeqLen; n++)
+	{
+		Hash = (Hash ^ (uint32_t)Seq[n]) * 0x9E3779B97F4A7C15ull;
+		Hash ^= Hash >> 29;
+	}
+	Hash ^= SeqLen;
+	return Hash == 0 ? 1 : Hash;
+}
+
+static bool RecordIsFor(const sCacheRecord *p, uint64_t Hash, const int Seq[], int SeqLen, const sSolver *pSolver)
+{
+	return p->Hash == Hash && p->Engine == pSolver->Engine && p->ClosedForms == pSolver->ClosedForms
+		&& p->SeqLen == SeqLen && memcmp(p->Seq, Seq, SeqLen * sizeof(Seq[0])) == 0;
+}
+
+// Copies the sequence's record into *pRecord, if it's in the cache.
+static bool LookUpRecord(sResultCache *pCache, const int Seq[], int SeqLen, const sSolver *pSolver, sCacheRecord *pRecord)
+{
+	uint64_t Hash = SequenceHash(Seq, SeqLen, pSolver);
+	uint32_t Mask = pCache->pHeader->NumRecords - 1;
+	const sCacheRecord *p;
+	int Probe;
+	lock_guard<mutex> Guard(pCache->Lock);
+
+	for (Probe = 0; Probe < CACHE_PROBES; Probe++)
+	{
+		p = &pCache->Records[(Hash + Probe) & Mask];
+		// Records are only ever replaced, never emptied, so an empty one means we've looked everywhere it could be.
+		if (p->Hash == 0)
+			return false;
+		if (RecordIsFor(p, Hash, Seq, SeqLen, pSolver))
+		{
+			*pRecord = *p;
+			return true;
+		}
+	}
+	return false;
+}
+
+static void StoreRecord(sResultCache *pCache, const int Seq[], int SeqLen, const sSolver *pSolver, const sSolveResult *pResult)
+{
+	uint64_t Hash = SequenceHash(Seq, SeqLen, pSolver);
+	uint32_t Mask = pCache->pHeader->NumRecords - 1;
+	sCacheRecord *p;
+	int Probe;
+	lock_guard<mutex> Guard(pCache->Lock);
+
+	for (Probe = 0; Probe < CACHE_PROBES; Probe++)
+	{
+		p = &pCache->Records[(Hash + Probe) & Mask];
+		if (p->Hash == 0 || RecordIsFor(p, Hash, Seq, SeqLen, pSolver))
+			break;
+	}
+	// No room, so throw one of the others away. Which one depends on the hash, so it's different for different sequences.
+	if (Probe == CACHE_PROBES)
+		p = &pCache->Records[(Hash + (Hash >> 32) % CACHE_PROBES) & Mask];
+
+	memset(p, 0, sizeof(*p));
+	p->Engine = pSolver->Engine;
+	p->ClosedForms = pSolver->ClosedForms;
+	p->SeqLen = SeqLen;
+	memcpy(p->Seq, Seq, SeqLen * sizeof(Seq[0]));
+	p->Solved = pResult->Success;
+	p->ClosedForm = pResult->Success && pResult->ClosedForm;
+	p->Attempt = pResult->Attempt;
+	p->MaxRetroS = pResult->MaxRetroS;
+	if (pResult->Success)
+	{
+		p->NumSeeds = pResult->NumSeeds;
+		p->NumItems = pResult->Formula.NumItems;
+		memcpy(p->Items, pResult->Formula.Items, pResult->Formula.NumItems * sizeof(p->Items[0]));
+		p->NextNum = pResult->Formula.NextNum;
+	}
+	// Last, so a half-written record never looks like it's there.
+	p->Hash = Hash;
+}
+
+// Fills in what the record says about the search. Returns false if it makes no sense, e.g. because the file got corrupted.
+static bool RecordToResult(const sCacheRecord *pRecord, sSolveResult *pResult)
+{
+	int inum, NumOperators;
+
+	if (pRecord->Attempt < 0 || pRecord->MaxRetroS < 0 || AttemptOperators(pRecord->Attempt, &NumOperators) == nullptr)
+		return false;
+	pResult->Success = pRecord->Solved != 0;
+	pResult->ClosedForm = pResult->Success && pRecord->ClosedForm != 0;
+	pResult->Attempt = pRecord->Attempt;
+	pResult->MaxRetroS = pRecord->MaxRetroS;
+	pResult->Task = -1;
+	if (!pResult->Success)
+		return true;
+	if (pRecord->NumItems < 1 || pRecord->NumItems > MAX_POSS_ITEMS_IN_EXPRESSION)
+		return false;
+	for (inum = 0; inum < pRecord->NumItems; inum++)
+	{
+		if (pRecord->Items[inum].ItemType < 0 || pRecord->Items[inum].ItemType >= NUM_ITEM_TYPES || pRecord->Items[inum].Index < 0
+		 || (pRecord->Items[inum].ItemType == OPERATOR && pRecord->Items[inum].Index >= NumOperators))
+		{
+			return false;
+		}
+	}
+	memcpy(pResult->Formula.Items, pRecord->Items, pRecord->NumItems * sizeof(pRecord->Items[0]));
+	pResult->Formula.NumItems = pRecord->NumItems;
+	pResult->Formula.Operators = AttemptOperators(pRecord->Attempt, &NumOperators);
+	pResult->Formula.NextNum = pRecord->NextNum;
+	pResult->NumSeeds = pRecord->NumSeeds;
+	return true;
+}
+
+bool SolveSequenceCached(sResultCache *pCache, sSolver *pSolver, int Seq[], int SeqLen, bool ShowProgress, const sSolveControl *pControl, sSolveResult *pResult)
+{
+	chrono::steady_clock::time_point StartTime = chrono::steady_clock::now();
+	sCacheRecord Record;
+	int Len;
+
+	// A shard's result is only part of the answer.
+	if (pCache == nullptr || pSolver->NumShards > 1)
+		return SolveSequence(pSolver, Seq, SeqLen, ShowProgress, pControl, pResult);
+
+	// Find the longest sequence we know about which this one starts with, which might be this one. There's no search at
+	// all for fewer than 3 numbers.
+	for (Len = SeqLen; Len >= 3; Len--)
+	{
+		if (LookUpRecord(pCache, Seq, Len, pSolver, &Record) && RecordToResult(&Record, pResult))
+			break;
+	}
+	pResult->Stopped = false;
+	if (Len < 3)
+	{
+		SolveSequence(pSolver, Seq, SeqLen, ShowProgress, pControl, pResult);
+	}
+	else if (pResult->Success && FormulaGeneratesSequence(&pResult->Formula, Seq, SeqLen))
+	{
+		// Same formula as before, or it carries on generating the extra numbers.
+	}
+	else if (pResult->ClosedForm)
+	{
+		// The closed form was solved for, so the steps before it might not all have been searched, and there's nothing to
+		// carry on from.
+		SolveSequence(pSolver, Seq, SeqLen, ShowProgress, pControl, pResult);
+	}
+	else if (pResult->Success)
+	{
+		// Other formulae from the step which found it might still fit, but nothing from before it.
+		ResumeSolveSequence(pSolver, Seq, SeqLen, pResult->MaxRetroS, pResult->Attempt, ShowProgress, pControl, pResult);
+	}
+	else
+	{
+		ResumeSolveSequence(pSolver, Seq, SeqLen, pResult->MaxRetroS, pResult->Attempt + 1, ShowProgress, pControl, pResult);
+	}
+	// If it was stopped, a formula it found might not be the simplest, so it's not the answer to keep, but how far it got
+	// without finding one is worth keeping so the next solve can carry on from there.
+	if (SeqLen >= 3 && !(pResult->Stopped && pResult->Success) && pResult->Attempt >= 0)
+		StoreRecord(pCache, Seq, SeqLen, pSolver, pResult);
+	pResult->ElapsedMs = chrono::duration<double, milli>(chrono::steady_clock::now() - StartTime).count();
+	return pResult->Success;
+}
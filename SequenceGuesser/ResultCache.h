@@ -0,0 +1,60 @@
+#pragma once
+
+#include <stdint.h>
+#include <mutex>
+#include "MappedFile.h"
+#include "Solver.h"
+
+// Results we've worked out before, kept in a file which is memory-mapped, so opening it costs next to nothing however big it
+// gets and a lookup is a few memory reads. It's a hash table of fixed-size records, one for each sequence (and engine, and
+// whether closed forms were solved for) we've been asked about, holding either the formula or, if there wasn't one, how
+// far the search got.
+#define CACHE_NUM_RECORDS	16384	// How many results a new cache file has room for. Must be a power of 2.
+#define CACHE_PROBES		8		// A sequence's record is in one of this many slots from where its hash says. If they're all
+									// taken, one of them is thrown away to make room.
+
+typedef struct {
+	uint64_t	Hash;		// Of the engine, ClosedForms and the sequence. 0 means the record is empty.
+	int32_t		Engine;
+	int32_t		ClosedForms;	// sSolver::ClosedForms, since with it a recurrence can be the answer where a search finds another.
+	int32_t		SeqLen;
+	int32_t		Seq[MAX_SEQ_LEN];
+	int32_t		Solved;
+	int32_t		ClosedForm;	// See sSolveResult::ClosedForm.
+	int32_t		Attempt;	// Which step of the search found the formula or, if none, the last step there was nothing in.
+	int32_t		MaxRetroS;
+	int32_t		NumSeeds;
+	int32_t		NumItems;
+	sItem		Items[MAX_POSS_ITEMS_IN_EXPRESSION];	// OPERATOR indices are into AttemptOperators(Attempt).
+	int64_t		NextNum;
+} sCacheRecord;
+
+typedef struct {
+	uint32_t	Magic;
+	uint32_t	RecordSize;	// sizeof(sCacheRecord), in case the file was written by a build where it's different.
+	uint64_t	Fingerprint;	// AttemptsFingerprint() when the file was made. Results from other attempts are no use to us.
+	uint32_t	NumRecords;
+	uint32_t	Version;	// CACHE_VERSION, which goes up whenever what's in a record changes.
+} sCacheHeader;
+
+typedef struct {
+	sMappedFile		File;
+	sCacheHeader	*pHeader;	// The start of the mapped file. The records follow it.
+	sCacheRecord	*Records;
+	std::mutex		Lock;		// Batch mode's workers share the cache.
+} sResultCache;
+
+// Opens the cache in FileName, making a new empty one if it doesn't exist or was made for different attempts.
+// Only one process at a time can have a cache file open, so this fails if another one has it.
+bool OpenResultCache(const char *FileName, sResultCache *pCache);
+
+void CloseResultCache(sResultCache *pCache);
+
+// Does what SolveSequence() does, but looks in the cache first. If we've seen the sequence before, that's the answer. If
+// we've seen a shorter sequence which this one starts with, we check its formula first and, if it doesn't fit, only search
+// from the step which found it, since nothing before that could fit the shorter sequence, let alone this one. Whatever we
+// find goes in the cache, apart from a formula found by a solve which was stopped. pCache may be nullptr, in which case it's
+// just SolveSequence(), and so is a solve by one of several shards (see sSolver::NumShards), since that's only part of the
+// answer. A solve which was stopped without a formula stores how far it got, and the next one carries on from there. Any
+// number of threads can use the same cache at once, each with its own solver.
+bool SolveSequenceCached(sResultCache *pCache, sSolver *pSolver, int Seq[], int SeqLen, bool ShowProgress, const sSolveControl *pControl, sSolveResult *pResult);
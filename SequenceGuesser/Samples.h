@@ -0,0 +1,15 @@
+#pragma once
+
+#include "Solver.h"
+
+// The sample sequences which the user can pick from in the UI. The benchmark runs them too.
+static struct {
+	int SeqLen;
+	int Seq[MAX_SEQ_LEN];
+} Samples[] = {
+	{ 10,	1, 2, 3, 5, 8, 13, 21, 34, 55, 89 },		// Fibonacci series.
+	{  7,	1, 2, 5, 13, 34, 89, 233 },					// Every other Fibonacci number.
+	{  9,	1, 3, 7, 15, 31, 63, 127, 255, 511 },		// Number of moves required to solve Tower of Hanoi puzzle given how many discs are involved.
+	{  6,	1, 36, 1225, 41616, 1413721, 48024900 },	// Numbers which are both square numbers and triangular numbers.
+};
+#define NUM_SAMPLES ((int)(sizeof(Samples)/sizeof(Samples[0])))
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include "Lanes.h"
+#include "Solver.h"
+
+// Positions 0..MAX_SEQ_LEN (the last being for the next number), rounded up to a whole number of lanes.
+#define NUM_POSITIONS	LANES_ROUND_UP(MAX_SEQ_LEN + 1)
+
+// Keeps an eye on a solve for its sSolveControl. The searches call SearchStopped() every so often, which is when we find out
+// that it's time to give up, and when OnProgress and OnCheckpoint get called.
+typedef struct {
+	const sSolveControl	*pControl;
+	std::chrono::steady_clock::time_point	StartTime;
+	std::atomic<bool>		Stopped;		// Once it's set, everything gives up as soon as it notices.
+	std::atomic<long long>	NextProgressNs;	// When OnProgress is next due, since StartTime.
+	std::mutex				ProgressLock;	// Held while calling OnProgress, so it's only called from one thread at a time.
+	sSolveProgress			Progress;		// Which step is being searched. The rest is filled in when OnProgress is called.
+	std::atomic<int>		UnitsDone;		// How far through the step the search is, in whatever it counts, e.g. the depth first
+	int						NumUnits;		// search's tasks, out of this many.
+	bool					Checkpoints;	// Whether there's an OnCheckpoint to keep Checkpoint up to date for.
+	std::atomic<long long>	NextCheckpointNs;
+	std::mutex				CheckpointLock;	// Held while changing Checkpoint or calling OnCheckpoint with it.
+	sSearchCheckpoint		Checkpoint;		// Which step is being searched and, if the depth first search is doing it, where
+											// its tasks have got to. They copy their state in here every so often.
+} sSolveWatch;
+
+// Returns true if the search should give up, i.e. it's out of time or has been cancelled, and calls OnProgress if it's due.
+// It's quick, but not so quick that it should be called for every formula. pWatch may be nullptr, for no limits.
+bool SearchStopped(sSolveWatch *pWatch);
+
+// Everything the search needs to know about the job it's been given. Nothing but FoundTask changes during the search.
+// The operators aren't in here since each attempt has its own copy of the search, compiled for its operators.
+typedef struct {
+	// The sequence as doubles, starting at SeqLanes[NUM_POSITIONS]. The padding in front of it is what S(i-k) loads for the
+	// seed positions, which saves checking for them lane by lane. Their results are never looked at, but the padding is 1s
+	// rather than 0s so that they rarely divide by zero and make us look closer.
+	alignas(LANES_ALIGNMENT) double	SeqLanes[2 * NUM_POSITIONS];
+	alignas(LANES_ALIGNMENT) double	Positions[NUM_POSITIONS];	// 0, 1, 2... which is what i evaluates to.
+	// The running totals which "S(i-k) sum", "S(i-k) prod", "i sum" and "i prod" load, laid out like SeqLanes[] and
+	// Positions[], so that each of them costs no more than S(i-k) or i does. See FillRunningTotals().
+	alignas(LANES_ALIGNMENT) double	SeqSums[2 * NUM_POSITIONS];
+	alignas(LANES_ALIGNMENT) double	SeqProducts[2 * NUM_POSITIONS];
+	alignas(LANES_ALIGNMENT) double	PositionSums[NUM_POSITIONS];
+	alignas(LANES_ALIGNMENT) double	PositionProducts[NUM_POSITIONS];
+	const int	*pSeq;		// The sequence as the user gave it, for checking a fit exactly with FormulaGeneratesSequence().
+	int		SeqLen;
+	int		MaxItemsInExpression;	// 1+2*3 makes 5 items.
+	// NumIndexValsForItem[] assumes the order of item types in eItemType. Not good coding but lends itself to this very fast method using a look-up table. The order is asserted in main().
+	int		NumIndexValsForItem[NUM_ITEM_TYPES];
+	// Which formulae are new, i.e. weren't looked at by any of the searches SolveSequence() did before this one. They all
+	// have to bring something in that the earlier ones didn't have:
+	bool	NeedNewestS;		// An S(i-k) with the highest k, since the earlier searches went through everything without it.
+	int		NumOldOperators;	// Also an operator with an index from here on, since the earlier operators are in the same order...
+	int		OldMaxItems;		// ...unless they have more than this many items. 0 if this is the first attempt.
+	sSolveWatch	*pWatch;		// nullptr if there are no limits on how long it can take.
+	sRejectionStats	*pRejections;	// The solver's, which the depth first search adds to when it's finished.
+	int		Shard, NumShards;	// The run of the depth first search's tasks to search (see sSolver::NumShards).
+	const sSearchCheckpoint	*pResume;	// Where the depth first search's tasks carry on from, or nullptr to start them afresh.
+	int		FoundTask;			// Set by the search to the task which found the formula (see sSolveResult::Task).
+} sSearchLimits;
+
+// Works out the running totals in *pLimits from SeqLanes[] and Positions[], which must be filled in.
+void FillRunningTotals(sSearchLimits *pLimits);
+
+// The values of "Leaf sum" (or "Leaf prod" if Product) in the lanes starting at position Pos. Leaf is an S(i-k) or i.
+static inline tLanes AggregateLanesAt(bool Product, const sItem *pLeaf, int Pos, const sSearchLimits *pLimits)
+{
+	if (pLeaf->ItemType == I)
+		return LanesLoad(Product ? &pLimits->PositionProducts[Pos] : &pLimits->PositionSums[Pos]);
+	return LanesLoadUnaligned((Product ? pLimits->SeqProducts : pLimits->SeqSums) + NUM_POSITIONS + Pos - pLeaf->Index - 1);
+}
+
+// The things an item can bring into a formula which make it new (see sSearchLimits).
+#define NOVEL_S			1
+#define NOVEL_OPERATOR	2
+
+static inline unsigned int ItemNovelty(const sItem *pItem, const sSearchLimits *pLimits)
+{
+	if (pItem->ItemType == S && pItem->Index == pLimits->NumIndexValsForItem[S] - 1)
+		return NOVEL_S;
+	if (pItem->ItemType == OPERATOR && pItem->Index >= pLimits->NumOldOperators)
+		return NOVEL_OPERATOR;
+	return 0;
+}
+
+// Whether a formula of NumItems items, whose items between them bring in Novelty, is new.
+static inline bool FormulaIsNew(unsigned int Novelty, int NumItems, const sSearchLimits *pLimits)
+{
+	return (!pLimits->NeedNewestS || (Novelty & NOVEL_S) != 0) && ((Novelty & NOVEL_OPERATOR) != 0 || NumItems > pLimits->OldMaxItems);
+}
+
+// The lanes, in the lanes starting at position Pos, which hold positions From..To-1.
+static inline unsigned int LanesBetween(int Pos, int From, int To)
+{
+	From = From <= Pos ? 0 : From - Pos;
+	To = To - Pos >= NUM_LANES ? NUM_LANES : To - Pos;
+	return From >= To ? 0 : ((1u << To) - 1) & ~((1u << From) - 1);
+}
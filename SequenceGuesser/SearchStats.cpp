@@ -0,0 +1,111 @@
+#include "stdafx.h"
+#include <string.h>
+#include <mutex>
+#include <set>
+#include "SearchStats.h"
+using namespace std;
+
+// The counts of threads which have finished, and the threads which haven't, so GetSearchStats() can add theirs on too.
+static mutex StatsLock;
+static sSearchStats FinishedThreadsStats;
+static set<sThreadSearchStats *> RunningThreads;
+
+thread_local sThreadSearchStats ThreadSearchStats;
+
+static const char *PruneRuleNames[NUM_PRUNE_RULES] = {
+	"operator_operand_operator",
+	"same_operands",
+	"constants",
+	"same_operands_constant",
+	"operands_order",
+	"cancels_out",
+	"inverse_unary",
+	"unary_order",
+	"one_does_nothing",
+	"aggregate_operand",
+	"stack_too_high",
+	"too_few_operands",
+	"not_new",
+	"nonsense",
+};
+
+static void AddSearchStats(sSearchStats *pTotal, const sSearchStats *pStats)
+{
+	const uint64_t *pFrom = (const uint64_t *)pStats;
+	uint64_t *pTo = (uint64_t *)pTotal;
+	size_t n;
+
+	// It's nothing but uint64s.
+	for (n = 0; n < sizeof(sSearchStats) / sizeof(uint64_t); n++)
+		pTo[n] += pFrom[n];
+}
+
+sThreadSearchStats::sThreadSearchStats()
+{
+	lock_guard<mutex> Guard(StatsLock);
+
+	memset(&Stats, 0, sizeof(Stats));
+	RunningThreads.insert(this);
+}
+
+sThreadSearchStats::~sThreadSearchStats()
+{
+	lock_guard<mutex> Guard(StatsLock);
+
+	AddSearchStats(&FinishedThreadsStats, &Stats);
+	RunningThreads.erase(this);
+}
+
+bool SearchStatsEnabled(void)
+{
+#ifdef SEQUENCEGUESSER_STATS
+	return true;
+#else
+	return false;
+#endif
+}
+
+void GetSearchStats(sSearchStats *pStats)
+{
+	lock_guard<mutex> Guard(StatsLock);
+
+	*pStats = FinishedThreadsStats;
+	for (sThreadSearchStats *pThread : RunningThreads)
+		AddSearchStats(pStats, &pThread->Stats);
+}
+
+// Writes out the counts, leaving off the zeros at the end, which there are usually a lot of.
+static void WriteCountsJson(ostream& Out, const uint64_t Counts[], int NumCounts)
+{
+	int n;
+
+	while (NumCounts > 0 && Counts[NumCounts - 1] == 0)
+		NumCounts--;
+	Out << "[";
+	for (n = 0; n < NumCounts; n++)
+		Out << (n > 0 ? "," : "") << Counts[n];
+	Out << "]";
+}
+
+void WriteSearchStatsJson(ostream& Out)
+{
+	sSearchStats Stats;
+	int r;
+
+	GetSearchStats(&Stats);
+	Out << "{\"enabled\":" << (SearchStatsEnabled() ? "true" : "false");
+	Out << ",\"generated_by_length\":";
+	WriteCountsJson(Out, Stats.Generated, MAX_POSS_ITEMS_IN_EXPRESSION + 1);
+	Out << ",\"pruned\":{";
+	for (r = 0; r < NUM_PRUNE_RULES; r++)
+		Out << (r > 0 ? "," : "") << "\"" << PruneRuleNames[r] << "\":" << Stats.Pruned[r];
+	Out << "},\"evaluated\":" << Stats.Evaluated;
+	Out << ",\"failed_at_position\":";
+	WriteCountsJson(Out, Stats.FailedAt, MAX_SEQ_LEN);
+	Out << ",\"failed_nonsense\":" << Stats.FailedNonsense;
+	Out << ",\"attempt_searches\":";
+	WriteCountsJson(Out, Stats.AttemptSearches, MAX_STATS_ATTEMPTS);
+	Out << ",\"attempt_ns\":";
+	WriteCountsJson(Out, Stats.AttemptNs, MAX_STATS_ATTEMPTS);
+	Out << "}";
+}
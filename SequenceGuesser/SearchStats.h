@@ -0,0 +1,72 @@
+#pragma once
+
+#include <stdint.h>
+#include <chrono>
+#include <iostream>
+#include "Solver.h"
+
+// Counts of what the depth first search did, and how long each attempt took, for finding out where the time goes. They're
+// only kept if the program is built with SEQUENCEGUESSER_STATS defined (the CMake option of the same name does it), since
+// even adding 1 to something for every formula shows up. Otherwise the STAT_ macros below compile to nothing.
+// Each thread has its own counts, so keeping them doesn't make the threads fight over cache lines.
+
+#define MAX_STATS_ATTEMPTS	8	// At least as many as there are attempts.
+
+// The reasons NextNode() and SearchTask() give for not going any further with a formula.
+typedef enum {
+	PRUNE_OPERATOR_OPERAND_OPERATOR,	// "+ x +" is "x + +", etc. All the rest up to PRUNE_AGGREGATE_OPERAND are in CheckOperatorValidHere().
+	PRUNE_SAME_OPERANDS,				// "x x +" is "x 2 *" and "x x *" is "x ^2".
+	PRUNE_CONSTANTS,					// "2 3 +" is "5".
+	PRUNE_SAME_OPERANDS_CONSTANT,		// "x x /" is "1" and "x x -" is "0".
+	PRUNE_OPERANDS_ORDER,				// "b a +" is "a b +".
+	PRUNE_CANCELS_OUT,					// "x + x -" does nothing.
+	PRUNE_INVERSE_UNARY,				// "^2 sqrt" does nothing.
+	PRUNE_UNARY_ORDER,					// "^3 ^2" is "^2 ^3".
+	PRUNE_ONE_DOES_NOTHING,				// "x 1 *" and "x 1 /" are "x", and "1 ^2" is "1".
+	PRUNE_AGGREGATE_OPERAND,			// "sum" and "prod" only go straight after S(i-k) or i.
+	PRUNE_STACK_TOO_HIGH,				// An operand which leaves too much on the stack to get back down to 1 in time.
+	PRUNE_TOO_FEW_OPERANDS,				// An operator with not enough on the stack for it.
+	PRUNE_NOT_NEW,						// Nothing below here is new (see sSearchLimits).
+	PRUNE_NONSENSE,						// The formula so far gives nonsense, e.g. dividing by 0, so nothing below it can fit.
+	NUM_PRUNE_RULES
+} ePruneRule;
+
+typedef struct {
+	uint64_t	Generated[MAX_POSS_ITEMS_IN_EXPRESSION + 1];	// Formulae NextNode() came to, by how many items they have.
+	uint64_t	Pruned[NUM_PRUNE_RULES];
+	uint64_t	Evaluated;					// Formulae which were checked against the sequence.
+	uint64_t	FailedAt[MAX_SEQ_LEN];		// The position at which those which didn't fit were first found to be wrong...
+	uint64_t	FailedNonsense;				// ...or how many were found to give nonsense instead.
+	uint64_t	AttemptSearches[MAX_STATS_ATTEMPTS];	// How many times each attempt was searched (by GuessSequence())...
+	uint64_t	AttemptNs[MAX_STATS_ATTEMPTS];			// ...and how long it took altogether, in nanoseconds.
+} sSearchStats;
+
+// The calling thread's counts, which are added to the totals when the thread finishes.
+struct sThreadSearchStats {
+	sSearchStats	Stats;
+
+	sThreadSearchStats();
+	~sThreadSearchStats();
+};
+
+extern thread_local sThreadSearchStats ThreadSearchStats;
+
+#ifdef SEQUENCEGUESSER_STATS
+#define STAT_ADD(Field, n)				(ThreadSearchStats.Stats.Field += (n))
+#define STAT_TIMER_START(Name)			std::chrono::steady_clock::time_point Name = std::chrono::steady_clock::now()
+#define STAT_TIMER_ADD(Name, Field)		STAT_ADD(Field, std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - Name).count())
+#else
+#define STAT_ADD(Field, n)				((void)0)
+#define STAT_TIMER_START(Name)			((void)0)
+#define STAT_TIMER_ADD(Name, Field)		((void)0)
+#endif
+#define STAT_INC(Field)					STAT_ADD(Field, 1)
+
+// Whether the counts are being kept, i.e. SEQUENCEGUESSER_STATS was defined.
+bool SearchStatsEnabled(void);
+
+// Adds up the counts of every thread so far. Only call it when nothing is being searched.
+void GetSearchStats(sSearchStats *pStats);
+
+// Writes the counts out as a JSON object, on one line.
+void WriteSearchStatsJson(std::ostream& Out);
@@ -1,484 +1,388 @@
-/*
-Improvements to make:
-
-Need new operators:
-	- Modulo - should be easy.
-	- Sum and Product operators (Sigma and Pi).
-
-Try changing S to be just another unary operator, "S", which operates on the last value on the stack.
-See if that's any faster.
-*/
-
 #include "stdafx.h"
 #include <assert.h>
 #include <math.h>
-#include <time.h>
-#include <chrono>
-#include <atlstr.h>
+#include <signal.h>
+#include <string.h>
+#include <atomic>
+#include <fstream>
 #include <iostream>
 #include <string>
+#include "Batch.h"
+#include "Daemon.h"
+#include "FormulaLibrary.h"
+#include "ResultCache.h"
+#include "Samples.h"
+#include "SearchStats.h"
+#include "Shard.h"
+#include "Solver.h"
+#include "WorkStealingPool.h"
 using namespace std;
 
-typedef enum { CONSTANT, S, I, OPERATOR, NUM_ITEM_TYPES } eItemType; // Don't change order.
-#define INC_TYPE(x) x = static_cast<eItemType>(1 + static_cast<int>(x))
-
-#define MAX_POSS_ITEMS_IN_EXPRESSION	20	// Beyond that and it would probably take a very long time.
-#define MAX_SEQ_LEN	50 // Number of numbers in a sequence e.g. 1+2*3 makes 5 items. This includes a "space" for the next number at the end.
+// Gets a sequence from the user and returns the number of numbers in it.
+int GetSequenceFromUser(int Seq[])
+{
+	string s;
+	int SampleNum, n;
 
-// Below are the sample sequences which the user can use through the UI.
-static struct {
-	int SeqLen;
-	int Seq[MAX_SEQ_LEN];
-} Samples[] = {
-	{ 10,	1, 2, 3, 5, 8, 13, 21, 34, 55, 89 },		// Fibonacci series.
-	{  7,	1, 2, 5, 13, 34, 89, 233 },					// Every other Fibonacci number.
-	{  9,	1, 3, 7, 15, 31, 63, 127, 255, 511 },		// Number of moves required to solve Tower of Hanoi puzzle given how many discs are involved.
-	{  6,	1, 36, 1225, 41616, 1413721, 48024900 },	// Numbers which are both square numbers and triangular numbers.
-};
-#define NUM_SAMPLES (sizeof(Samples)/sizeof(Samples[0]))
+	// Ask the user to provide a sequence or select one of the samples provided.
+	cout << "Please enter a sequence of numbers separated by commas or whitespace," << endl;
+	cout << "or a letter corresponding to one of the sample sequences provided below." << endl;
+	cout << "or \"q\" or \"quit\" to quit." << endl << endl;
+	for (SampleNum = 0; SampleNum < NUM_SAMPLES; SampleNum++)
+	{
+		cout << "   " << (char)('A' + SampleNum) << ".  " << Samples[SampleNum].Seq[0];
+		for (n = 1; n < Samples[SampleNum].SeqLen; n++)
+		{
+			cout << ", " << Samples[SampleNum].Seq[n];
+		}
+		cout << endl;
+	}
+	cout << endl << endl;
 
-typedef double(*pOperatorFn) (double a, double b);
-typedef struct {
-	char		*Display;	// How we display this operation on the console, e.g. "+".
-	int			NumOperands;
-	pOperatorFn	pOpFunction;
-	bool		Available;	// Whether we're using it in this attempt.
-} sOperator;
-double AddOpFn(double a, double b)				{ return a + b; }
-double SubtractOpFn(double a, double b)			{ return a - b; }
-double MultiplyOpFn(double a, double b)			{ return a * b; }
-double DivideOpFn(double a, double b)			{ return a / b; }
-double SquareOpFn(double a, double b)			{ return b * b; }
-double CubeOpFn(double a, double b)				{ return b * b * b; }
-double SqRootOpFn(double a, double b)			{ return sqrt(b); }
-double DigitFromRightOpFn(double a, double b)	{ return int(a / pow(10, b)) % 10; }				// Digit 0 is units, 1 is tens, 2 is hundreds etc.
-double DigitFromLeftOpFn(double a, double b)	{ return DigitFromRightOpFn(a, log10(a) - b); }	// Digit 0 is leftmost digit, 1 is next etc.
+	// Keep getting user input until we get a valid one.
+	for (;;)
+	{
+		cin.clear();
+		getline(cin, s, '\n');
+		if (s[0] == 'Q' || s[0] == 'q')
+			return 0;
+		if (s.length() == 1)
+		{
+			s[0] = tolower(s[0]);
+			if (s[0] >= 'a' && s[0] < 'a' + NUM_SAMPLES)
+			{
+				// User has selected one of the sample sequences by entering its letter.
+				SampleNum = s[0] - 'a';
+				memcpy(Seq, Samples[SampleNum].Seq, Samples[SampleNum].SeqLen * sizeof(Samples[SampleNum].Seq[0]));
+				return Samples[SampleNum].SeqLen;
+			}
+		}
+		// User should have entered a sequence of numbers separated by commas or whitespace. Tokenize it into numbers.
+		n = ParseSequence(s, Seq);
+		if (n > 1)
+			return n;
+		cout << "Invalid input. Please enter a letter e.g. \"A\" or a sequence of up to " << MAX_SEQ_LEN - 1 << " whole numbers e.g. \"1, 4, 9, 16, 25\"" << endl;
+	}
+}
 
-sOperator AddOp				= { "+", 2, AddOpFn };
-sOperator SubtractOp		= { "-", 2, SubtractOpFn };
-sOperator MultiplyOp		= { "*", 2, MultiplyOpFn };
-sOperator DivideOp			= { "/", 2, DivideOpFn };
-sOperator SquareOp			= { "^2", 1, SquareOpFn };
-sOperator CubeOp			= { "^3", 1, CubeOpFn };
-sOperator SqRootOp			= { "sqrt", 1, SqRootOpFn };
-sOperator DigitFromRightOp	= { "rdigit", 2, DigitFromRightOpFn };
-sOperator DigitFromLeftOp	= { "ldigit", 2, DigitFromLeftOpFn };
+// How often we tell the user how a long solve is getting on.
+#define PROGRESS_INTERVAL_MS	5000
 
-#define MAX_OP_CONSUMPTION 2 // The greatest number of operands any operator can take.
-#define MAX_POSS_OPERATORS 20
-sOperator *Operators[MAX_POSS_OPERATORS];
+// Set by Ctrl+C while we're solving, to stop the search and show what it's found out so far.
+static atomic<bool> Interrupted(false);
 
-static struct {
-	int MaxItemsInExpression;	// 1+2*3 makes 5 items.
-	sOperator* Operators[MAX_POSS_OPERATORS];
-} Attempts[] = {
-	// Start off with short strings and most likely operators, then check longer strings and more ops on later attempts.
-	{	 3,	{ &AddOp },																											},
-	{	 3,	{ &AddOp, &SubtractOp },																							},
-	{	 5,	{ &AddOp, &SubtractOp, &MultiplyOp, &DivideOp },																	},
-	{	10,	{ &AddOp, &SubtractOp, &MultiplyOp, &DivideOp, &SquareOp },															},
-#if 0
-	// ^^^ We could use these extra operations but it dramatically increases the time taken to solve even the simplest sequences.
-	{	10,	{ &AddOp, &SubtractOp, &MultiplyOp, &DivideOp, &SquareOp, &CubeOp, &SqRootOp }										},
-	{	20,	{ &AddOp, &SubtractOp, &MultiplyOp, &DivideOp, &SquareOp, &CubeOp, &SqRootOp, &DigitFromLeftOp, &DigitFromRightOp }	}
-#endif
-};
-#define NUM_ATTEMPTS (sizeof(Attempts) / sizeof(Attempts[0]))
+static void OnInterrupt(int)
+{
+	Interrupted = true;
+}
 
-typedef struct {
-	eItemType	ItemType;
-	int			Index;
-} sItem;
+static void ShowProgress(const sSolveProgress& Progress)
+{
+	printf("\n(Still going after %.0fs: attempt %d, formulae of up to %d items looking back to S(i-%d), about %.0f%% through it. Ctrl+C to stop.)\n",
+		   Progress.ElapsedMs / 1000, Progress.Attempt, Progress.MaxItems, Progress.MaxRetroS > 1 ? Progress.MaxRetroS : 1, Progress.Fraction * 100);
+	fflush(stdout);
+}
 
-// This function determines how much the stack would increase by given the item we've found in the formula string.
-static int GetStackHeightIncrease(eItemType e, int Index)
+static bool SaveSearchStats(const char *FileName)
 {
-	if (e == OPERATOR)
-	{
-		return 1 - Operators[Index]->NumOperands;
-	}
-	else
+	ofstream Out(FileName);
+
+	WriteSearchStatsJson(Out);
+	Out << endl;
+	if (!Out)
 	{
-		return 1;
+		cerr << "Can't write " << FileName << endl;
+		return false;
 	}
+	return true;
+}
+
+// Every mode's way out once it's done: closes the cache and library (nullptr if they weren't opened) and saves the stats if
+// they were asked for, which turns ExitCode into 2 if it can't.
+static int Finish(int ExitCode, sResultCache *pCache, sFormulaLibrary *pLibrary, const char *StatsJsonFile)
+{
+	if (pCache != nullptr)
+		CloseResultCache(pCache);
+	if (pLibrary != nullptr)
+		CloseFormulaLibrary(pLibrary);
+	if (StatsJsonFile != nullptr && !SaveSearchStats(StatsJsonFile))
+		ExitCode = 2;
+	return ExitCode;
+}
+
+static void ShowUsage(void)
+{
+	cout << "Usage:" << endl;
+	cout << "  SequenceGuesser                                  Asks you for sequences one at a time." << endl;
+	cout << "  SequenceGuesser --batch [FILE] [--workers N]     Solves the sequences in FILE (or stdin if FILE is missing" << endl;
+	cout << "                                                   or \"-\"), one per line, N at a time, writing a JSON record" << endl;
+	cout << "                                                   for each to stdout." << endl;
+	cout << "  SequenceGuesser --daemon SOCKET [--workers N]    Runs as a server on the Unix socket SOCKET, solving the" << endl;
+	cout << "                                                   sequences its clients send, N at a time. A client can also" << endl;
+	cout << "                                                   send \"stats\" for the queue and latencies, or \"shutdown\"." << endl;
+	cout << "  SequenceGuesser --client SOCKET                  Sends the lines on stdin to the server and writes what it" << endl;
+	cout << "                                                   sends back to stdout." << endl;
+	cout << "  --engine dfs|bottomup                            Which search to use in either mode. dfs (the default) walks" << endl;
+	cout << "                                                   through the formulae one at a time. bottomup builds them up" << endl;
+	cout << "                                                   smallest first and never tries two which give the same values." << endl;
+	cout << "  --cache FILE                                     Remembers results in FILE, so sequences (and longer versions" << endl;
+	cout << "                                                   of them) which have been solved before are answered at once." << endl;
+	cout << "  --library FILE                                   Looks up formulae with no seeds in FILE before searching." << endl;
+	cout << "  --time-limit MS                                  Gives up on a sequence after MS milliseconds, saying what" << endl;
+	cout << "                                                   it's ruled out. Ctrl+C does the same in interactive mode." << endl;
+	cout << "  --no-closed-form                                 Searches for polynomials and linear recurrences like any" << endl;
+	cout << "                                                   other formula, rather than solving for them first." << endl;
+	cout << "  --portfolio N                                    Searches N steps (attempts and how far back to look) at once," << endl;
+	cout << "                                                   sharing the threads between them, so that a formula found in" << endl;
+	cout << "                                                   a later step only waits for the steps before it. The answer" << endl;
+	cout << "                                                   is the same, but there are no progress reports." << endl;
+	cout << "  --stats-json FILE                                Writes what the search did (how many formulae of each length" << endl;
+	cout << "                                                   it came to, why it skipped them, where they went wrong and" << endl;
+	cout << "                                                   how long each attempt took) to FILE as JSON, when it's" << endl;
+	cout << "                                                   finished. Needs a build with SEQUENCEGUESSER_STATS defined." << endl;
+	cout << "  SequenceGuesser --solve SEQUENCE [--shard K/N] [--checkpoint FILE]" << endl;
+	cout << "                                                   Solves SEQUENCE (e.g. 1,4,9,16) and writes a JSON record" << endl;
+	cout << "                                                   like batch mode's. With --shard, only does the Kth (from 0)" << endl;
+	cout << "                                                   of N equal runs of each step's depth first search, so N" << endl;
+	cout << "                                                   processes, e.g. on different machines, can share it out." << endl;
+	cout << "                                                   With --checkpoint, saves where it's got to in FILE every" << endl;
+	cout << "                                                   minute and when it's stopped, and carries on from there." << endl;
+	cout << "  SequenceGuesser --merge                          Reads every shard's --solve record on stdin and writes the" << endl;
+	cout << "                                                   one the whole search would have given." << endl;
+	cout << "  SequenceGuesser --build-library FILE [--items N] [--prefix K] [--attempt A]" << endl;
+	cout << "                                                   Works out every formula with no seeds of up to N items (7)" << endl;
+	cout << "                                                   with the operators of attempt A (the last), and saves them in" << endl;
+	cout << "                                                   FILE for --library, indexed by the first K numbers (4)." << endl;
 }
 
-static bool CheckOperatorValidHere(sItem *Items, int NumItems)
+int main(int argc, char *argv[])
 {
-	// There is no point testing certain sequences since they will be covered by other, equivalent sequences.
-	if (NumItems >= 3)
+	int SeqLen, arg, NumWorkers;
+	bool Batch;
+	const char *BatchFile;
+	const char *DaemonSocket;
+	const char *ClientSocket;
+	const char *CacheFile;
+	const char *LibraryFile;
+	const char *BuildLibraryFile;
+	const char *StatsJsonFile;
+	const char *SolveSequenceText;
+	const char *CheckpointFile;
+	bool Merge;
+	int LibraryItems, LibraryPrefix, LibraryAttempt, NumOperators;
+	sSolver Solver;
+	unsigned int ElapsedMs;
+	int Seq[MAX_SEQ_LEN];
+	sSolveControl Control;
+	sSolveResult Result;
+	sResultCache Cache;
+	sResultCache *pCache;
+	sFormulaLibrary Library;
+	sFormulaLibrary *pLibrary;
+	int ExitCode;
+
+	// NumIndexValsForItem[] assumes the order of item types in eItemType. Not good coding but lends itself to this very fast method using a look-up table.
+	// The order is asserted in here.
+	assert(CONSTANT == 0 && S == 1 && I == 2 && OPERATOR == 3 && NUM_ITEM_TYPES == 4);
+
+	Batch = false;
+	BatchFile = nullptr;
+	DaemonSocket = nullptr;
+	ClientSocket = nullptr;
+	NumWorkers = DefaultNumThreads();
+	InitSolver(&Solver, DEPTH_FIRST_ENGINE, DefaultNumThreads());
+	CacheFile = nullptr;
+	LibraryFile = nullptr;
+	BuildLibraryFile = nullptr;
+	LibraryItems = 7;
+	LibraryPrefix = 4;
+	LibraryAttempt = -1;
+	StatsJsonFile = nullptr;
+	SolveSequenceText = nullptr;
+	CheckpointFile = nullptr;
+	Merge = false;
+	Control.TimeLimitMs = 0;
+	Control.pCancel = nullptr;
+	Control.ProgressIntervalMs = 0;
+	Control.CheckpointIntervalMs = 0;
+	for (arg = 1; arg < argc; arg++)
 	{
-		if (Items[NumItems - 3].ItemType == OPERATOR && Items[NumItems - 2].ItemType != OPERATOR) // Assume Items[NumItems-1] is an operator because of the name of this fn.
-		{
-			/* Various combinations of operator operand operator can be skipped. E.g. +x+ = x++ so don't check since "+ operand +" since it will be checked later as "operand + +".
-				+x+ = x++
-				-x- = x+-
-				*x* = x**
-				dxd = x*d   'd' means division sign. I can't type it properly because the compiler will think it's a C++ comment.
-				+x- = x-+
-				-x+ = x--
-				*xd = xd*
-				dx* = xdd
-			*/
-			if (Operators[Items[NumItems - 3].Index]->pOpFunction == AddOpFn || Operators[Items[NumItems - 3].Index]->pOpFunction == SubtractOpFn)
-			{
-				if (Operators[Items[NumItems - 1].Index]->pOpFunction == AddOpFn || Operators[Items[NumItems - 1].Index]->pOpFunction == SubtractOpFn)
-					return false;
-			}
-			else if (Operators[Items[NumItems - 3].Index]->pOpFunction == MultiplyOpFn || Operators[Items[NumItems - 3].Index]->pOpFunction == DivideOpFn)
-			{
-				if (Operators[Items[NumItems - 1].Index]->pOpFunction == MultiplyOpFn || Operators[Items[NumItems - 1].Index]->pOpFunction == DivideOpFn)
-					return false;
-			}
+		if (strcmp(argv[arg], "--batch") == 0)
+		{
+			Batch = true;
+			if (arg + 1 < argc && strncmp(argv[arg + 1], "--", 2) != 0)
+				BatchFile = argv[++arg];
 		}
-		if ((Operators[Items[NumItems - 1].Index] == &AddOp && MultiplyOp.Available)	// xx+ = x2*
-			|| (Operators[Items[NumItems - 1].Index] == &MultiplyOp && SquareOp.Available))	// xx* = x squared
+		else if (strcmp(argv[arg], "--daemon") == 0 && arg + 1 < argc)
 		{
-			if (Items[NumItems - 3].ItemType != OPERATOR
-			 && Items[NumItems - 3].ItemType == Items[NumItems - 2].ItemType
-			 && Items[NumItems - 3].Index == Items[NumItems - 2].Index)
-			{
-				return false;
-			}
+			DaemonSocket = argv[++arg];
 		}
-		// CONSTANT CONSTANT + [or - or *] (since equals a different constant)
-		if (Items[NumItems - 3].ItemType == CONSTANT && Items[NumItems - 2].ItemType == CONSTANT
-		&&	 (Operators[Items[NumItems - 1].Index] == &AddOp
-		   || Operators[Items[NumItems - 1].Index] == &SubtractOp
-		   || Operators[Items[NumItems - 1].Index] == &MultiplyOp))
+		else if (strcmp(argv[arg], "--client") == 0 && arg + 1 < argc)
 		{
-			return false;
+			ClientSocket = argv[++arg];
 		}
-		// OPERAND SAME_OPERAND /      e.g. 5 5 / would be 5 divided by 5 = 1.
-		if (Items[NumItems - 3].ItemType != OPERATOR && Items[NumItems - 2].ItemType == Items[NumItems - 3].ItemType
-		 && Items[NumItems - 3].Index == Items[NumItems - 2].Index
-		 && Operators[Items[NumItems - 1].Index] == &DivideOp)
+		else if (strcmp(argv[arg], "--workers") == 0 && arg + 1 < argc && atoi(argv[arg + 1]) >= 1)
 		{
-			return false;
+			NumWorkers = atoi(argv[++arg]);
 		}
-		// Should rule out one of ab+ and ba+ (and for *).
-		// When we get to ba+ we know that ab+ will already have been done. Ordering of a and b is known from their item type and indices.
-		if (Items[NumItems - 3].ItemType != OPERATOR
-			&& Items[NumItems - 2].ItemType != OPERATOR
-			&& (Operators[Items[NumItems - 1].Index] == &AddOp || Operators[Items[NumItems - 1].Index] == &MultiplyOp)
-			&& (Items[NumItems - 3].ItemType > Items[NumItems - 2].ItemType || (Items[NumItems - 3].ItemType == Items[NumItems - 2].ItemType
-				&& Items[NumItems - 3].Index > Items[NumItems - 2].Index)))
+		else if (strcmp(argv[arg], "--engine") == 0 && arg + 1 < argc && strcmp(argv[arg + 1], "dfs") == 0)
 		{
-			return false;
+			Solver.Engine = DEPTH_FIRST_ENGINE;
+			arg++;
 		}
-		if (NumItems >= 4)
+		else if (strcmp(argv[arg], "--engine") == 0 && arg + 1 < argc && strcmp(argv[arg + 1], "bottomup") == 0)
 		{
-			// OPERAND + SAME_OPERAND - [or swap + and -]
-			// OPERAND * SAME_OPERAND / [or swap * and /]
-			if (Items[NumItems - 4].ItemType != OPERATOR && Items[NumItems - 4].ItemType == Items[NumItems - 2].ItemType
-				&& Items[NumItems - 4].Index == Items[NumItems - 2].Index)
-			{
-				if ((Operators[Items[NumItems - 3].Index] == &AddOp && Operators[Items[NumItems - 1].Index] == &SubtractOp)
-					|| (Operators[Items[NumItems - 1].Index] == &AddOp && Operators[Items[NumItems - 3].Index] == &SubtractOp))
-				{
-					return false;
-				}
-				if ((Operators[Items[NumItems - 3].Index] == &MultiplyOp && Operators[Items[NumItems - 1].Index] == &DivideOp)
-					|| (Operators[Items[NumItems - 1].Index] == &MultiplyOp && Operators[Items[NumItems - 3].Index] == &DivideOp))
-				{
-					return false;
-				}
-			}
+			Solver.Engine = BOTTOM_UP_ENGINE;
+			arg++;
 		}
-	}
-	// Do this one last because it applies to the little-used square and sqrt ops so more efficient to check common ops above first.
-	if (NumItems >= 2)
-	{
-		// sq sqrt or vice versa.
-		if (Items[NumItems - 2].ItemType == OPERATOR
-			&& ((Operators[Items[NumItems - 2].Index] == &SquareOp && Operators[Items[NumItems - 1].Index] == &SqRootOp)
-				|| (Operators[Items[NumItems - 1].Index] == &SquareOp && Operators[Items[NumItems - 2].Index] == &SqRootOp)))
+		else if (strcmp(argv[arg], "--cache") == 0 && arg + 1 < argc)
 		{
-			return false;
+			CacheFile = argv[++arg];
 		}
-	}
-	return true;
-}
-
-static void SpitFormula(sItem Items[], int NumItems)
-{
-	int inum;
-
-	cout << "If you can read reverse polish, each number S(i) in the series S is given by:" << endl;
-	for (inum = 0; inum < NumItems; inum++)
-	{
-		switch (Items[inum].ItemType)
-		{
-		case OPERATOR:
-			cout << " " << Operators[Items[inum].Index]->Display;
-			break;
-		case CONSTANT:
-			cout << " " << (Items[inum].Index + 1);
-			break;
-		case I:
-			cout << " i";
-			break;
-		case S:
-			cout << " S(i-" << (Items[inum].Index + 1) << ")";
-			break;
-		default:
-			assert(false);
+		else if (strcmp(argv[arg], "--library") == 0 && arg + 1 < argc)
+		{
+			LibraryFile = argv[++arg];
 		}
-	}
-	cout << endl;
-}
-
-static bool GuessSequence (int Seq[], int SeqLen,	int MaxItemsInExpression,	// 1+2*3 makes 5 items.
-													int NumOperators,
-													int MaxRetroS)				// How far back in the sequence you look. MaxRetroS == x means back as far as S(i-x).
-{
-	// NumIndexValsForItem[] assumes the order of item types in eItemType. Not good coding but lends itself to this very fast method using a look-up table. The order is asserted in main().
-	static int NoIndexForI = 0;
-	static int All9Constants = 9;
-	static int* NumIndexValsForItem[NUM_ITEM_TYPES] = {
-		&All9Constants,	// CONSTANT. Need all constants 1-9. 0 is never needed in formulas.
-		&MaxRetroS,		// S. See block comment above.
-		&NoIndexForI,	// I => index not used.
-		&NumOperators	// OPERATOR.
-	};
-	sItem Items[MAX_POSS_ITEMS_IN_EXPRESSION];
-	int StackHeight, sh, NumItems, i, inum;
-	bool KeepChecking, ByeIntoNextInSeq, ItemValid, Ready;
-	double NewNum;
-	double Stack[MAX_POSS_ITEMS_IN_EXPRESSION];
-	bool Success;
-	eItemType NewItemType;
-
-	assert(NumOperators >= 1 && MaxItemsInExpression <= MAX_POSS_ITEMS_IN_EXPRESSION);
-
-	StackHeight = 0;
-	NumItems = 0;
-
-	// When we want to tack another item onto the end of the string, that item will be a constant.
-	NewItemType = CONSTANT;
-
-	for (Success = false, ItemValid = true; !Success; )
-	{
-		// Enlarge the expression.
-		if (ItemValid && NumItems < MaxItemsInExpression)
+		else if (strcmp(argv[arg], "--build-library") == 0 && arg + 1 < argc)
 		{
-			Items[NumItems].ItemType = NewItemType;
-			Items[NumItems].Index = 0;
-			NumItems += 1;
-			StackHeight += GetStackHeightIncrease(Items[NumItems - 1].ItemType, Items[NumItems - 1].Index);
+			BuildLibraryFile = argv[++arg];
 		}
-		else
+		else if (strcmp(argv[arg], "--items") == 0 && arg + 1 < argc && atoi(argv[arg + 1]) >= 1)
 		{
-			ItemValid = true;
-			for (Ready = false; !Ready; )
-			{
-				Ready = true;
-				StackHeight -= GetStackHeightIncrease(Items[NumItems - 1].ItemType, Items[NumItems - 1].Index);
-				if (Items[NumItems - 1].Index < *NumIndexValsForItem[Items[NumItems - 1].ItemType] - 1)
-				{
-					Items[NumItems - 1].Index += 1;
-				}
-				else
-				{
-					// Already at last index for this item type so go to next type.
-					if (Items[NumItems - 1].ItemType < NUM_ITEM_TYPES - 1)
-					{
-						INC_TYPE(Items[NumItems - 1].ItemType);
-						Items[NumItems - 1].Index = 0;
-					}
-					else
-					{
-						// Already at last type so go back to previous item.
-						if (NumItems == 1)
-						{
-							// Already come all the way back to first item and exhausted it, so finish.
-							return Success;
-						}
-						NumItems -= 1;
-						Ready = false;
-					}
-				}
-			}
-			StackHeight += GetStackHeightIncrease(Items[NumItems - 1].ItemType, Items[NumItems - 1].Index);
+			LibraryItems = atoi(argv[++arg]);
 		}
-		// Need to set ItemValid indicating whether this item can go here, with or without needing further items after it to create a valid formula,
-		// E.g. S(i) = 1 i    is not worth checking because a valid solution would need to end up with a stack height of 1, but the 'i' is valid because
-		//                    this formula might go on to become S(i) = 1 i +
-		if (Items[NumItems - 1].ItemType != OPERATOR)
+		else if (strcmp(argv[arg], "--prefix") == 0 && arg + 1 < argc && atoi(argv[arg + 1]) >= 1)
 		{
-			// If just added an operand, check stack height isn't so high that we can't come down to 1 by end of expression.
-			ItemValid = StackHeight - (MaxItemsInExpression - NumItems) * (MAX_OP_CONSUMPTION - 1) <= 1;
-			if (!ItemValid)
-			{
-				// If stack too high to take another operand, no point just trying another operand so skip them and go to the operators.
-				StackHeight -= GetStackHeightIncrease(Items[NumItems - 1].ItemType, Items[NumItems - 1].Index);
-				Items[NumItems - 1].ItemType = OPERATOR;
-				Items[NumItems - 1].Index = 0;
-				StackHeight += GetStackHeightIncrease(OPERATOR, 0);
-				// Check for combinations which would be checked for at some other point.
-				ItemValid = CheckOperatorValidHere(Items, NumItems);
-			}
+			LibraryPrefix = atoi(argv[++arg]);
 		}
-		else if (Items[NumItems - 1].ItemType == OPERATOR)
+		else if (strcmp(argv[arg], "--attempt") == 0 && arg + 1 < argc && atoi(argv[arg + 1]) >= 0)
 		{
-			// If just added an operator, check we have enough operands already on the stack for it to operate on.
-			ItemValid = StackHeight >= Operators[Items[NumItems - 1].Index]->NumOperands;
-			ItemValid = ItemValid && CheckOperatorValidHere(Items, NumItems);
+			LibraryAttempt = atoi(argv[++arg]);
 		}
-		if (ItemValid && StackHeight == 1)
+		else if (strcmp(argv[arg], "--stats-json") == 0 && arg + 1 < argc)
 		{
-			// This might now equal S(i). Evaluate if expression true for all i.
-			KeepChecking = true;
-			// We loop until i == SeqLen, i.e. 1 more than you might expect, because
-			// we use that last loop to generate the next number in the sequence after the numbers the user provided.
-			for (i = 0; KeepChecking && i <= SeqLen; i++)
-			{
-				sh = 0;
-				for (ByeIntoNextInSeq = false, inum = 0; !ByeIntoNextInSeq && inum < NumItems; inum++)
-				{
-					switch (Items[inum].ItemType)
-					{
-					case OPERATOR:
-						NewNum = Operators[Items[inum].Index]->pOpFunction(Stack[sh - 2], Stack[sh - 1]);
-						sh -= Operators[Items[inum].Index]->NumOperands;
-						Stack[sh] = NewNum;
-						sh += 1;
-						break;
-					case CONSTANT:
-						Stack[sh] = Items[inum].Index + 1;
-						sh += 1;
-						break;
-					case I:
-						Stack[sh] = i;
-						sh += 1;
-						break;
-					case S:
-						if (i > Items[inum].Index)
-						{
-							Stack[sh] = Seq[i - Items[inum].Index - 1];
-							sh += 1;
-						}
-						else
-						{
-							// Can't refer to S(i-3) if we're only 1 step into the sequence.
-							// Skip this but keep checking rest of sequence.
-							ByeIntoNextInSeq = true;
-						}
-						break;
-					default:
-						assert(false);
-					}
-				}
-				if (!ByeIntoNextInSeq)
-				{
-					if (i < SeqLen)
-					{
-						if (Stack[0] != Seq[i])
-						{
-							// This formula failed to generate the correct number for one of the numbers in the sequence.
-							KeepChecking = false;
-						}
-					}
-					else
-					{
-						// i == SeqLen so we were using this loop to generate the next number in the series after the ones the user provided.
-						// Use printf until I figure out how to make cout handle the long int.
-						printf("\nGot it! The next number is %li\n", (long int) Stack[0]);
-						SpitFormula(Items, NumItems);
-						Success = true;
-						KeepChecking = false;
-					}
-				}
-			}
+			StatsJsonFile = argv[++arg];
+		}
+		else if (strcmp(argv[arg], "--time-limit") == 0 && arg + 1 < argc && atof(argv[arg + 1]) > 0)
+		{
+			Control.TimeLimitMs = atof(argv[++arg]);
+		}
+		else if (strcmp(argv[arg], "--no-closed-form") == 0)
+		{
+			Solver.ClosedForms = false;
+		}
+		else if (strcmp(argv[arg], "--portfolio") == 0 && arg + 1 < argc && atoi(argv[arg + 1]) >= 1)
+		{
+			Solver.PortfolioSize = atoi(argv[++arg]);
+		}
+		else if (strcmp(argv[arg], "--solve") == 0 && arg + 1 < argc)
+		{
+			SolveSequenceText = argv[++arg];
+		}
+		else if (strcmp(argv[arg], "--shard") == 0 && arg + 1 < argc
+			  && sscanf(argv[arg + 1], "%d/%d", &Solver.Shard, &Solver.NumShards) == 2 && Solver.Shard >= 0 && Solver.Shard < Solver.NumShards)
+		{
+			arg++;
+		}
+		else if (strcmp(argv[arg], "--checkpoint") == 0 && arg + 1 < argc)
+		{
+			CheckpointFile = argv[++arg];
+		}
+		else if (strcmp(argv[arg], "--merge") == 0)
+		{
+			Merge = true;
+		}
+		else
+		{
+			ShowUsage();
+			return 2;
 		}
 	}
-	return Success;
-}
-
-static unsigned int NoteTime(void)
-{
-	std::chrono::system_clock::time_point TimeNow;
-	static time_t Last_tt, Next_tt;
-	double Diff_tm;
-	static bool BeenHereBefore = false;
-
-	if (!BeenHereBefore)
+	if (ClientSocket != nullptr)
+		return RunDaemonClient(ClientSocket, cin, cout);
+	if (Merge)
+		return MergeShardRecords(cin, cout);
+	// Sharing out a search or saving checkpoints only makes sense for one sequence.
+	if ((Solver.NumShards > 1 || CheckpointFile != nullptr) && SolveSequenceText == nullptr)
 	{
-		TimeNow = std::chrono::system_clock::now();
-		Last_tt = std::chrono::system_clock::to_time_t(TimeNow);
-		BeenHereBefore = true;
+		ShowUsage();
+		return 2;
+	}
+	if (StatsJsonFile != nullptr && !SearchStatsEnabled())
+		cerr << "This build doesn't keep the search's stats (SEQUENCEGUESSER_STATS isn't defined), so they'll all be 0." << endl;
+	if (BuildLibraryFile != nullptr)
+	{
+		if (LibraryAttempt < 0)
+		{
+			for (LibraryAttempt = 0; AttemptOperators(LibraryAttempt + 1, &NumOperators) != nullptr; LibraryAttempt++)
+				;
+		}
+		if (!BuildFormulaLibrary(BuildLibraryFile, LibraryAttempt, LibraryItems, LibraryPrefix, cout))
+		{
+			cerr << "Couldn't build " << BuildLibraryFile << endl;
+			return 2;
+		}
 		return 0;
 	}
-	TimeNow = std::chrono::system_clock::now();
-	Next_tt = std::chrono::system_clock::to_time_t(TimeNow);
-	Diff_tm = difftime(Next_tt, Last_tt);
-	Last_tt = Next_tt;
-	return (unsigned int)Diff_tm;
-}
-
-// Gets a sequence from the user and returns the number of numbers in it.
-int GetSequenceFromUser(int Seq[])
-{
-	string s;
-	char *p;
-	char* pContext;
-	int SampleNum, n;
-
-	// Ask the user to provide a sequence or select one of the samples provided.
-	cout << "Please enter a sequence of numbers separated by commas or whitespace," << endl;
-	cout << "or a letter corresponding to one of the sample sequences provided below." << endl;
-	cout << "or \"q\" or \"quit\" to quit." << endl << endl;
-	for (SampleNum = 0; SampleNum < NUM_SAMPLES; SampleNum++)
+	pLibrary = nullptr;
+	if (LibraryFile != nullptr)
 	{
-		cout << "   " << (char)('A' + SampleNum) << ".  " << Samples[SampleNum].Seq[0];
-		for (n = 1; n < Samples[SampleNum].SeqLen; n++)
+		if (!OpenFormulaLibrary(LibraryFile, &Library))
 		{
-			cout << ", " << Samples[SampleNum].Seq[n];
+			cerr << "Can't open " << LibraryFile << " (was it built by this version?)" << endl;
+			return 2;
 		}
-		cout << endl;
+		pLibrary = &Library;
+		Solver.pLibrary = pLibrary;
 	}
-	cout << endl << endl;
-
-	// Keep getting user input until we get a valid one.
-	for (;;)
+	if (SolveSequenceText != nullptr)
 	{
-		cin.clear();
-		getline(cin, s, '\n');
-		if (s[0] == 'Q' || s[0] == 'q')
-			return 0;
-		if (s.length() == 1)
+		SeqLen = ParseSequence(SolveSequenceText, Seq);
+		if (SeqLen < 2)
 		{
-			s[0] = tolower(s[0]);
-			if (s[0] >= 'a' && s[0] < 'a' + NUM_SAMPLES)
-			{
-				// User has selected one of the sample sequences by entering its letter.
-				SampleNum = s[0] - 'a';
-				int asdf = Samples[SampleNum].SeqLen * sizeof(Samples[SampleNum].Seq[0]);
-				memcpy(Seq, Samples[SampleNum].Seq, Samples[SampleNum].SeqLen * sizeof(Samples[SampleNum].Seq[0]));
-				return Samples[SampleNum].SeqLen;
-			}
+			cerr << "\"" << SolveSequenceText << "\" isn't a sequence." << endl;
+			return 2;
 		}
-		// User should have entered a sequence of numbers separated by commas or whitespace. Tokenize it into numbers.
-		for (n = 0, p = strtok_s(&s[0], ", \t", &pContext); p != nullptr; p = strtok_s(nullptr, ", \t", &pContext))
+		// It doesn't use the cache, since a shard's result is only part of the answer.
+		// Ctrl+C, or the cluster killing the job, stops the solve, which saves a checkpoint first.
+		Control.pCancel = &Interrupted;
+		signal(SIGINT, OnInterrupt);
+		signal(SIGTERM, OnInterrupt);
+		ExitCode = RunShard(Seq, SeqLen, &Solver, &Control, CheckpointFile, cout);
+		return Finish(ExitCode, nullptr, pLibrary, StatsJsonFile);
+	}
+	pCache = nullptr;
+	if (CacheFile != nullptr)
+	{
+		if (!OpenResultCache(CacheFile, &Cache))
 		{
-			Seq[n++] = atoi(p);
+			cerr << "Can't open " << CacheFile << " (is something else using it?)" << endl;
+			return Finish(2, nullptr, pLibrary, nullptr);
 		}
-		if (n > 1)
-			return n;
-		cout << "Invalid input. Please enter a letter e.g. \"A\" or a sequence of numbers e.g. \"1, 4, 9, 16, 25\"" << endl;
+		pCache = &Cache;
+	}
+	if (DaemonSocket != nullptr)
+	{
+		ExitCode = RunDaemon(DaemonSocket, NumWorkers, &Solver, Control.TimeLimitMs > 0 ? &Control : nullptr, pCache);
+		return Finish(ExitCode, pCache, pLibrary, StatsJsonFile);
+	}
+	if (Batch)
+	{
+		ExitCode = 2;
+		if (BatchFile == nullptr || strcmp(BatchFile, "-") == 0)
+		{
+			ExitCode = RunBatch(cin, cout, NumWorkers, &Solver, Control.TimeLimitMs > 0 ? &Control : nullptr, pCache) == 0 ? 0 : 1;
+		}
+		else
+		{
+			ifstream In(BatchFile);
+			if (In)
+				ExitCode = RunBatch(In, cout, NumWorkers, &Solver, Control.TimeLimitMs > 0 ? &Control : nullptr, pCache) == 0 ? 0 : 1;
+			else
+				cerr << "Can't open " << BatchFile << endl;
+		}
+		return Finish(ExitCode, pCache, pLibrary, StatsJsonFile);
 	}
-}
-
-int main()
-{
-	int a, NumOperators, SeqLen, MaxRetroS;
-	bool Success;
-	unsigned int ElapsedTime;
-	int Seq[MAX_SEQ_LEN];
-
-	// NumIndexValsForItem[] assumes the order of item types in eItemType. Not good coding but lends itself to this very fast method using a look-up table.
-	// The order is asserted in here.
-	assert(CONSTANT == 0 && S == 1 && I == 2 && OPERATOR == 3 && NUM_ITEM_TYPES == 4);
 
 	cout << "======================" << endl;
 	cout << "=                    =" << endl;
@@ -487,44 +391,46 @@ int main()
 	cout << "======================" << endl << endl;
 	cout << "This program allows you to specify a sequence of numbers and it will guess the next number in the sequence." << endl << endl;
 
+	// The user can see how it's going, and stop it, however long it takes.
+	Control.pCancel = &Interrupted;
+	Control.ProgressIntervalMs = PROGRESS_INTERVAL_MS;
+	Control.OnProgress = ShowProgress;
+
 	// Keep asking user for more series to work with until they type "quit".
 	for (	SeqLen = GetSequenceFromUser(Seq);
 			SeqLen >= 1;
 			SeqLen = GetSequenceFromUser(Seq))
 	{
-		Success = false;
 		cout << "Hmm. Let's try this..." << endl;
-		for (MaxRetroS = 0; !Success && MaxRetroS < SeqLen - 2; MaxRetroS++)
+		fflush(stdout);
+		// Only while solving, so Ctrl+C still quits at the prompt.
+		Interrupted = false;
+		signal(SIGINT, OnInterrupt);
+		SolveSequenceCached(pCache, &Solver, Seq, SeqLen, true, &Control, &Result);
+		signal(SIGINT, SIG_DFL);
+		ElapsedMs = (unsigned int)Result.ElapsedMs;
+		if (Result.Success)
 		{
-			for (a = 0; a < NUM_ATTEMPTS; a++)
-			{
-				for (NumOperators = 0; NumOperators < MAX_POSS_OPERATORS && Attempts[a].Operators[NumOperators]; NumOperators++)
-				{
-					Operators[NumOperators] = Attempts[a].Operators[NumOperators];
-					Operators[NumOperators]->Available = true;
-				}
-				if (NumOperators < MAX_POSS_OPERATORS)
-					Operators[NumOperators] = nullptr;
-				NoteTime();
-				Success = GuessSequence(Seq, SeqLen, Attempts[a].MaxItemsInExpression, NumOperators, MaxRetroS);
-				ElapsedTime = NoteTime();
-				if (Success)
-				{
-					// Use printf() because it supports the format specifiers we need.
-					printf("Took me %02d:%02d:%02d.\n", ElapsedTime / 3600, ElapsedTime / 60 % 60, ElapsedTime % 60);
-					break;
-				}
-				else
-				{
-					cout << "Hmm...";
-				}
-			}
+			printf("\nGot it! The next number is %lld\n", Result.Formula.NextNum);
+			SpitFormula(&Result.Formula);
+			if (Result.Stopped)
+				cout << "I stopped before I'd ruled out all the simpler formulae though, so there might be a better one." << endl;
+			// Use printf() because it supports the format specifiers we need.
+			printf("Took me %02u:%02u:%02u.%03u.\n", ElapsedMs / 3600000, ElapsedMs / 60000 % 60, ElapsedMs / 1000 % 60, ElapsedMs % 1000);
 		}
-		if (!Success)
+		else if (Result.Stopped)
+		{
+			cout << endl << "I gave up after " << ElapsedMs / 1000 << "s. ";
+			if (Result.Attempt < 0)
+				cout << "I hadn't ruled anything out yet." << endl;
+			else
+				cout << "No formula up to attempt " << Result.Attempt << " looking back as far as S(i-" << max(Result.MaxRetroS, 1) << ") fits." << endl;
+		}
+		else
 		{
 			cout << endl << "Gah! Sorry, I couldn't work out the next number. :-(" << endl;
 		}
 		cout << endl << endl << "---------------------------------------------------" << endl << endl;
 	}
-	return 0;
+	return Finish(0, pCache, pLibrary, StatsJsonFile);
 }
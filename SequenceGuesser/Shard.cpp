@@ -0,0 +1,274 @@
+#include "stdafx.h"
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <tuple>
+#include <vector>
+#include "Checkpoint.h"
+#include "Shard.h"
+#include "Solver.h"
+using namespace std;
+
+// What a shard's record says. The merged record is the same, without the shard.
+typedef struct {
+	string		Sequence;	// As it's written in the record, e.g. "[1,2,3]".
+	int			Shard;		// -1 for the merged record.
+	int			NumShards;
+	string		Status;		// "solved", "unsolved" or "timeout".
+	long long	Next;
+	string		Formula;
+	int			NumSeeds;
+	int			MaxRetroS;	// Where the formula was found or, for a timeout, the last step which was searched all the way.
+	int			Attempt;
+	int			Task;
+	bool		Stopped;
+	double		ElapsedMs;
+} sShardRecord;
+
+// Where in the search something is: (MaxRetroS, Attempt, Task), which is the order the search gets to them in.
+typedef tuple<int, int, int> tSearchPlace;
+
+// The formula only contains digits, letters and "S(i-k)" so needs no escaping.
+static string WriteShardRecord(const sShardRecord *pRecord)
+{
+	ostringstream Record;
+
+	Record << "{\"sequence\":" << pRecord->Sequence;
+	if (pRecord->Shard >= 0)
+		Record << ",\"shard\":" << pRecord->Shard;
+	Record << ",\"shards\":" << pRecord->NumShards << ",\"status\":\"" << pRecord->Status << "\"";
+	if (pRecord->Status == "solved")
+	{
+		Record << ",\"next\":" << pRecord->Next << ",\"formula\":\"" << pRecord->Formula << "\",\"seeds\":" << pRecord->NumSeeds;
+		Record << ",\"attempt\":" << pRecord->Attempt << ",\"max_retro_s\":" << pRecord->MaxRetroS << ",\"task\":" << pRecord->Task;
+		if (pRecord->Stopped)
+			Record << ",\"stopped\":true";
+	}
+	else if (pRecord->Status == "timeout")
+	{
+		Record << ",\"searched_attempt\":" << pRecord->Attempt << ",\"searched_max_retro_s\":" << pRecord->MaxRetroS;
+	}
+	Record << ",\"ms\":" << fixed << setprecision(3) << pRecord->ElapsedMs << "}";
+	return Record.str();
+}
+
+// Puts what comes after "Name": in the record into *pValue: a string without its quotes, a whole array, or anything else up
+// to the next comma or brace. It's only for our own records, which have nothing nested and nothing that needs escaping.
+static bool FindField(const string& Line, const char *Name, string *pValue)
+{
+	string Key = string("\"") + Name + "\":";
+	size_t Start, End;
+
+	if ((Start = Line.find(Key)) == string::npos)
+		return false;
+	Start += Key.size();
+	if (Start < Line.size() && Line[Start] == '"')
+		End = Line.find('"', ++Start);
+	else if (Start < Line.size() && Line[Start] == '[')
+	{
+		if ((End = Line.find(']', Start)) != string::npos)
+			End++;
+	}
+	else
+		End = Line.find_first_of(",}", Start);
+	if (End == string::npos)
+		return false;
+	*pValue = Line.substr(Start, End - Start);
+	return true;
+}
+
+static bool FindInt(const string& Line, const char *Name, long long *pValue)
+{
+	string Value;
+	char *pEnd;
+
+	if (!FindField(Line, Name, &Value) || Value.empty())
+		return false;
+	*pValue = strtoll(Value.c_str(), &pEnd, 10);
+	return *pEnd == '\0';
+}
+
+static bool ParseShardRecord(const string& Line, sShardRecord *pRecord)
+{
+	string Value;
+	long long Shard, NumShards, NumSeeds, MaxRetroS, Attempt, Task;
+
+	if (!FindField(Line, "sequence", &pRecord->Sequence) || !FindInt(Line, "shard", &Shard) || !FindInt(Line, "shards", &NumShards)
+	 || !FindField(Line, "status", &pRecord->Status) || !FindField(Line, "ms", &Value))
+	{
+		return false;
+	}
+	pRecord->Shard = (int)Shard;
+	pRecord->NumShards = (int)NumShards;
+	pRecord->ElapsedMs = atof(Value.c_str());
+	pRecord->Stopped = FindField(Line, "stopped", &Value) && Value == "true";
+	if (pRecord->Status == "solved")
+	{
+		if (!FindInt(Line, "next", &pRecord->Next) || !FindField(Line, "formula", &pRecord->Formula) || !FindInt(Line, "seeds", &NumSeeds)
+		 || !FindInt(Line, "attempt", &Attempt) || !FindInt(Line, "max_retro_s", &MaxRetroS) || !FindInt(Line, "task", &Task))
+		{
+			return false;
+		}
+		pRecord->NumSeeds = (int)NumSeeds;
+		pRecord->Task = (int)Task;
+	}
+	else if (pRecord->Status == "timeout")
+	{
+		if (!FindInt(Line, "searched_attempt", &Attempt) || !FindInt(Line, "searched_max_retro_s", &MaxRetroS))
+			return false;
+	}
+	else if (pRecord->Status == "unsolved")
+	{
+		Attempt = MaxRetroS = -1;
+	}
+	else
+	{
+		return false;
+	}
+	pRecord->Attempt = (int)Attempt;
+	pRecord->MaxRetroS = (int)MaxRetroS;
+	return true;
+}
+
+// The shard has searched everything before this.
+static tSearchPlace SearchedUpTo(const sShardRecord *pRecord)
+{
+	if (pRecord->Status == "unsolved")
+		return tSearchPlace(INT_MAX, INT_MAX, INT_MAX);
+	if (pRecord->Status == "timeout")
+		return tSearchPlace(pRecord->MaxRetroS, pRecord->Attempt, INT_MAX);
+	// If it was stopped, it had searched the steps before the formula's, but maybe not the tasks before its.
+	return tSearchPlace(pRecord->MaxRetroS, pRecord->Attempt, pRecord->Stopped ? INT_MIN : pRecord->Task);
+}
+
+int RunShard(int Seq[], int SeqLen, sSolver *pSolver, const sSolveControl *pControl, const char *CheckpointFile, ostream& Out)
+{
+	sSolveControl Control = sSolveControl();
+	sSearchCheckpoint Checkpoint;
+	sSolveResult Result;
+	sShardRecord Record;
+	ostringstream Sequence;
+	bool Resume = false;
+	int n;
+
+	if (pControl != nullptr)
+		Control = *pControl;
+	if (CheckpointFile != nullptr)
+	{
+		// Don't overwrite anything which isn't one of our checkpoints.
+		Resume = ifstream(CheckpointFile).good();
+		if (Resume && !LoadCheckpoint(CheckpointFile, Seq, SeqLen, pSolver, &Checkpoint))
+		{
+			cerr << CheckpointFile << " isn't a checkpoint of this sequence and shard (or it was made by another version)." << endl;
+			return 2;
+		}
+		Control.CheckpointIntervalMs = CHECKPOINT_INTERVAL_MS;
+		Control.OnCheckpoint = [&](const sSearchCheckpoint& Latest)
+		{
+			if (!SaveCheckpoint(CheckpointFile, Seq, SeqLen, pSolver, &Latest))
+				cerr << "Couldn't save a checkpoint in " << CheckpointFile << endl;
+		};
+	}
+	if (Resume)
+		ResumeFromCheckpoint(pSolver, Seq, SeqLen, &Checkpoint, false, &Control, &Result);
+	else
+		SolveSequence(pSolver, Seq, SeqLen, false, &Control, &Result);
+	// A solve which wasn't stopped has nothing left to carry on with.
+	if (CheckpointFile != nullptr && !Result.Stopped)
+		remove(CheckpointFile);
+
+	Sequence << "[";
+	for (n = 0; n < SeqLen; n++)
+		Sequence << (n > 0 ? "," : "") << Seq[n];
+	Sequence << "]";
+	Record.Sequence = Sequence.str();
+	Record.Shard = pSolver->Shard;
+	Record.NumShards = pSolver->NumShards;
+	Record.Status = Result.Success ? "solved" : Result.Stopped ? "timeout" : "unsolved";
+	Record.Stopped = Result.Success && Result.Stopped;
+	Record.MaxRetroS = Result.MaxRetroS;
+	Record.Attempt = Result.Attempt;
+	if (Result.Success)
+	{
+		Record.Next = Result.Formula.NextNum;
+		Record.Formula = FormulaToString(&Result.Formula);
+		Record.NumSeeds = Result.NumSeeds;
+		Record.Task = Result.Task;
+	}
+	Record.ElapsedMs = Result.ElapsedMs;
+	Out << WriteShardRecord(&Record) << endl;
+	return Result.Success ? 0 : 1;
+}
+
+int MergeShardRecords(istream& In, ostream& Out)
+{
+	vector<sShardRecord> Records;
+	vector<bool> Seen;
+	sShardRecord Record, Merged;
+	const sShardRecord *pBest = nullptr;
+	tSearchPlace Searched(INT_MAX, INT_MAX, INT_MAX);
+	string Line;
+
+	while (getline(In, Line))
+	{
+		if (Line.find_first_not_of(" \t\r") == string::npos)
+			continue;
+		if (!ParseShardRecord(Line, &Record))
+		{
+			cerr << "That isn't a shard's record: " << Line << endl;
+			return 2;
+		}
+		if (!Records.empty() && (Record.Sequence != Records[0].Sequence || Record.NumShards != Records[0].NumShards))
+		{
+			cerr << "That's from a different solve: " << Line << endl;
+			return 2;
+		}
+		Seen.resize(max(Record.NumShards, 0));
+		if (Record.Shard < 0 || Record.Shard >= Record.NumShards || Seen[Record.Shard])
+		{
+			cerr << "Shard " << Record.Shard << " of " << Record.NumShards << " is out of range or has already been seen." << endl;
+			return 2;
+		}
+		Seen[Record.Shard] = true;
+		Records.push_back(Record);
+	}
+	if (Records.empty() || (int)Records.size() != Records[0].NumShards)
+	{
+		cerr << "Only " << Records.size() << " of the shards' records were there." << endl;
+		return 2;
+	}
+
+	// The whole search's formula is the first one any shard found, as long as the others had searched everything before it.
+	for (const sShardRecord& Shard : Records)
+	{
+		Searched = min(Searched, SearchedUpTo(&Shard));
+		if (Shard.Status == "solved"
+		 && (pBest == nullptr || tSearchPlace(Shard.MaxRetroS, Shard.Attempt, Shard.Task) < tSearchPlace(pBest->MaxRetroS, pBest->Attempt, pBest->Task)))
+		{
+			pBest = &Shard;
+		}
+	}
+	if (pBest != nullptr)
+	{
+		Merged = *pBest;
+		Merged.Stopped = Searched < tSearchPlace(pBest->MaxRetroS, pBest->Attempt, pBest->Task);
+	}
+	else
+	{
+		Merged = Records[0];
+		Merged.Status = get<0>(Searched) == INT_MAX ? "unsolved" : "timeout";
+		Merged.MaxRetroS = get<0>(Searched);
+		Merged.Attempt = get<1>(Searched);
+	}
+	Merged.Shard = -1;
+	// They ran at the same time, so the whole solve took as long as the slowest.
+	for (const sShardRecord& Shard : Records)
+		Merged.ElapsedMs = max(Merged.ElapsedMs, Shard.ElapsedMs);
+	Out << WriteShardRecord(&Merged) << endl;
+	return Merged.Status == "solved" ? 0 : 1;
+}
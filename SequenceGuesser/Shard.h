@@ -0,0 +1,23 @@
+#pragma once
+
+#include <iostream>
+#include "Solver.h"
+
+// A solve too long for one machine, split between processes which can each be on a different one (see sSolver::NumShards),
+// and put back together afterwards.
+
+#define CHECKPOINT_INTERVAL_MS	60000	// How often a solve with a checkpoint file saves where it's got to.
+
+// Solves one sequence, or pSolver's shard of it, and writes a one-line JSON record like batch mode's (see Batch.h) to Out,
+// with where in the search the shard found its formula, e.g.
+//	{"sequence":[1,2,3,4],"shard":1,"shards":4,"status":"solved","next":5,"formula":"1 S(i-1) +","seeds":1,"attempt":0,"max_retro_s":0,"task":-1,"ms":0.041}
+// If CheckpointFile isn't nullptr, where the solve has got to is saved in it every CHECKPOINT_INTERVAL_MS and when it's
+// stopped, and if there's already a checkpoint in it, the solve carries on from there. It's deleted once the solve is done.
+// Returns 0 if it found a formula, 1 if not, or 2 if CheckpointFile has something else in it.
+int RunShard(int Seq[], int SeqLen, sSolver *pSolver, const sSolveControl *pControl, const char *CheckpointFile, std::ostream& Out);
+
+// Reads the records RunShard() wrote for every shard of a solve from In, in any order, and writes the record the whole
+// solve would have given to Out, which is the lowest of their formulae in search order, once the shards which didn't find
+// it have all searched everything before it. If some of them stopped before that, it's "stopped", like a solve that ran
+// out of time. Returns 0 if there's a formula, 1 if not, or 2 if the records aren't all the shards of one solve.
+int MergeShardRecords(std::istream& In, std::ostream& Out);
@@ -0,0 +1,1491 @@
+/*
+Improvements to make:
+
+Try changing S to be just another unary operator, "S", which operates on the last value on the stack.
+See if that's any faster.
+*/
+
+#include "stdafx.h"
+#include <assert.h>
+#include <errno.h>
+#include <limits.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "BottomUp.h"
+#include "ClosedForm.h"
+#include "FormulaLibrary.h"
+#include "MeetInTheMiddle.h"
+#include "Operators.h"
+#include "SearchLimits.h"
+#include "SearchStats.h"
+#include "Solver.h"
+#include "WorkStealingPool.h"
+using namespace std;
+
+#define INC_TYPE(x) x = static_cast<eItemType>(1 + static_cast<int>(x))
+
+#define MAX_OP_CONSUMPTION 2 // The greatest number of operands any operator can take.
+
+template <class tOps> static bool SearchAttempt(sSearchLimits *pLimits, eSearchEngine Engine, int NumThreads, sFormula *pFound);
+template <class tOps> static bool MeetInTheMiddleAttempt(sSearchLimits *pLimits, eSearchEngine Engine, int NumThreads, sFormula *pFound);
+template <class tOps> static bool FormulaSearched(const sItem Items[], int NumItems);
+
+static struct {
+	int MaxItemsInExpression;	// 1+2*3 makes 5 items.
+	int NumOperators;
+	const sOperator* const* Operators;
+	bool (*pSearch)(sSearchLimits *pLimits, eSearchEngine Engine, int NumThreads, sFormula *pFound);	// The search, compiled for the operators we're using in this attempt.
+	bool (*pSearched)(const sItem Items[], int NumItems);	// FormulaSearched() for the same operators.
+} Attempts[] = {
+#define ATTEMPT(MaxItems, ...)	{ MaxItems, tOperatorSet<__VA_ARGS__>::NumOperators, tOperatorSet<__VA_ARGS__>::Operators, SearchAttempt<tOperatorSet<__VA_ARGS__>>, FormulaSearched<tOperatorSet<__VA_ARGS__>> }
+// An attempt too long to search every formula of, which only looks for the ones made of two halves (see MeetInTheMiddle.h).
+#define MEET_IN_THE_MIDDLE_ATTEMPT(MaxItems, ...)	{ MaxItems, tOperatorSet<__VA_ARGS__>::NumOperators, tOperatorSet<__VA_ARGS__>::Operators, MeetInTheMiddleAttempt<tOperatorSet<__VA_ARGS__>>, FormulaSearched<tOperatorSet<__VA_ARGS__>> }
+	// Start off with short strings and most likely operators, then check longer strings and more ops on later attempts.
+	// Each attempt must have all the operators of the one before, in the same order, and be at least as long, since then
+	// it only has to look at the formulae which the one before couldn't have (see sSearchLimits).
+	ATTEMPT( 3,	ADD_OP),
+	ATTEMPT( 3,	ADD_OP, SUBTRACT_OP),
+	ATTEMPT( 5,	ADD_OP, SUBTRACT_OP, MULTIPLY_OP, DIVIDE_OP),
+	ATTEMPT(10,	ADD_OP, SUBTRACT_OP, MULTIPLY_OP, DIVIDE_OP, SQUARE_OP),
+	// Sum and prod cost little more than S(i-k) and i, since they only go straight after one and look up a running total.
+	// Modulo isn't here since, like any other binary operator, it would make this attempt take twice as long.
+	// With MaxRetroS 0, this comes before any plain recurrence looking back two, so sums can win there, e.g. Fibonacci is
+	// "2 S(i-1) sum S(i-1) - +" with --no-closed-form (see README.md). The recurrences which are solved for aren't affected.
+	MEET_IN_THE_MIDDLE_ATTEMPT(15,	ADD_OP, SUBTRACT_OP, MULTIPLY_OP, DIVIDE_OP, SQUARE_OP, SUM_OP, PRODUCT_OP),
+#if 0
+	// ^^^ We could use these extra operations but it dramatically increases the time taken to solve even the simplest sequences.
+	ATTEMPT(10,	ADD_OP, SUBTRACT_OP, MULTIPLY_OP, DIVIDE_OP, SQUARE_OP, SUM_OP, PRODUCT_OP, MODULO_OP, CUBE_OP, SQROOT_OP),
+	ATTEMPT(20,	ADD_OP, SUBTRACT_OP, MULTIPLY_OP, DIVIDE_OP, SQUARE_OP, SUM_OP, PRODUCT_OP, MODULO_OP, CUBE_OP, SQROOT_OP, DIGIT_FROM_LEFT_OP, DIGIT_FROM_RIGHT_OP),
+#endif
+#undef ATTEMPT
+#undef MEET_IN_THE_MIDDLE_ATTEMPT
+};
+#define NUM_ATTEMPTS ((int)(sizeof(Attempts) / sizeof(Attempts[0])))
+static_assert(NUM_ATTEMPTS <= MAX_STATS_ATTEMPTS, "sSearchStats needs room for every attempt");
+
+// This function determines how much the stack would increase by given the item we've found in the formula string.
+template <class tOps>
+static inline int GetStackHeightIncrease(eItemType e, int Index)
+{
+	if (e == OPERATOR)
+	{
+		return 1 - tOps::NumOperandsOf[Index];
+	}
+	else
+	{
+		return 1;
+	}
+}
+
+// There is no point testing certain formulae since they will be covered by other, equivalent formulae, e.g. "+ x +" is the
+// same as "x + +", which gets checked anyway. Whether an operator can go after the items before it depends on what the
+// last three of them are (which operator, or which type of operand) and, for some rules, on which operands they are. The
+// first part is worked out for every combination before we start, from what OperatorAlgebra[] says about the operators,
+// so when we come to check an operator it's one look in the table and maybe a compare or two.
+// An item's code is its type for an operand, or OPERATOR plus its index for an operator. NoItem is before the formula starts.
+template <class tOps>
+struct tPruneTable {
+	static const int NoItem = OPERATOR + tOps::NumOperators;
+	static const int NumCodes = NoItem + 1;
+	// Rules[((Code4 * NumCodes + Code3) * NumCodes + Code2) * NumOperators + Op] has bit r set if rule r (one of the
+	// ePruneRules up to PRUNE_AGGREGATE_OPERAND) rules out operator Op after items with codes Code4, Code3 and Code2.
+	typedef struct {
+		unsigned short	Rules[NumCodes * NumCodes * NumCodes * tOps::NumOperators];
+	} sRules;
+	static const sRules Table;
+};
+
+static_assert(PRUNE_AGGREGATE_OPERAND < 16, "tPruneTable needs a bit for every rule in it");
+
+// The rules which need to know which operands they're looking at, not just their types, and what they need to know.
+#define PRUNE_IF_SAME_OPERANDS	((1 << PRUNE_SAME_OPERANDS) | (1 << PRUNE_SAME_OPERANDS_CONSTANT))	// Items[n-3] is Items[n-2].
+#define PRUNE_IF_OUT_OF_ORDER	(1 << PRUNE_OPERANDS_ORDER)	// Items[n-3] comes after Items[n-2].
+#define PRUNE_IF_SAME_AROUND	(1 << PRUNE_CANCELS_OUT)	// Items[n-4] is Items[n-2].
+#define PRUNE_IF_ONE			(1 << PRUNE_ONE_DOES_NOTHING)	// Items[n-2] is 1, or Items[n-3] is and the operator is commutative.
+
+// Which rules could rule out operator Op after items with codes Code4, Code3 and Code2, i.e. its entry in tPruneTable.
+template <class tOps>
+constexpr unsigned int PruneRulesFor(int Code4, int Code3, int Code2, int Op)
+{
+	const sOperatorAlgebra& Algebra = OperatorAlgebra[tOps::KindOf[Op]];
+	eOperatorKind Kind3 = Code3 >= OPERATOR && Code3 < tPruneTable<tOps>::NoItem ? tOps::KindOf[Code3 - OPERATOR] : NUM_OPERATOR_KINDS;
+	eOperatorKind Kind2 = Code2 >= OPERATOR && Code2 < tPruneTable<tOps>::NoItem ? tOps::KindOf[Code2 - OPERATOR] : NUM_OPERATOR_KINDS;
+	unsigned int Rules = 0;
+
+	if (tOps::NumOperandsOf[Op] == 1)
+	{
+		// The running totals are only kept for S(i-k) and i.
+		if (Algebra.Aggregate && Code2 != S && Code2 != I)
+			Rules |= 1 << PRUNE_AGGREGATE_OPERAND;
+		if (Kind2 != NUM_OPERATOR_KINDS && sOperatorTable::ByKind[Kind2].NumOperands == 1)
+		{
+			// x op inv
+			if (OperatorAlgebra[Kind2].Inverse == tOps::KindOf[Op])
+				Rules |= 1 << PRUNE_INVERSE_UNARY;
+			// Only one order of two powers.
+			if (OperatorAlgebra[Kind2].Power && Algebra.Power && Kind2 > tOps::KindOf[Op])
+				Rules |= 1 << PRUNE_UNARY_ORDER;
+		}
+		// 1 op, if it turns out to be 1.
+		if (Code2 == CONSTANT && Algebra.OneDoesNothing)
+			Rules |= 1 << PRUNE_ONE_DOES_NOTHING;
+		return Rules;
+	}
+	// op1 x op2, where they're in the same group. We need the group's associative one to write it the other way.
+	if (Kind3 != NUM_OPERATOR_KINDS && sOperatorTable::ByKind[Kind3].NumOperands == 2 && Code2 < OPERATOR
+	 && AssociativeGroupOf(Kind3) != NUM_OPERATOR_KINDS && AssociativeGroupOf(Kind3) == AssociativeGroupOf(tOps::KindOf[Op])
+	 && tOps::Has(AssociativeGroupOf(Kind3)))
+	{
+		Rules |= 1 << PRUNE_OPERATOR_OPERAND_OPERATOR;
+	}
+	if (Code3 < OPERATOR && Code2 < OPERATOR)
+	{
+		// x x op, if they turn out to be the same x.
+		if (Code3 == Code2 && Algebra.SameOperandsAs != NUM_OPERATOR_KINDS && tOps::Has(Algebra.SameOperandsAs))
+			Rules |= 1 << PRUNE_SAME_OPERANDS;
+		if (Code3 == Code2 && Algebra.SameOperandsConstant)
+			Rules |= 1 << PRUNE_SAME_OPERANDS_CONSTANT;
+		if (Code3 == CONSTANT && Code2 == CONSTANT && Algebra.FoldsConstants)
+			Rules |= 1 << PRUNE_CONSTANTS;
+		// b a op, if b turns out to come after a.
+		if (Code3 >= Code2 && Algebra.Commutative)
+			Rules |= 1 << PRUNE_OPERANDS_ORDER;
+	}
+	// x 1 op (or 1 x op), if it turns out to be 1.
+	if (Algebra.OneDoesNothing && (Code2 == CONSTANT || (Code3 == CONSTANT && Code2 < OPERATOR && Algebra.Commutative)))
+		Rules |= 1 << PRUNE_ONE_DOES_NOTHING;
+	// x op1 x op2, where op2 undoes op1, if they turn out to be the same x.
+	if (Code4 < OPERATOR && Code4 == Code2 && Kind3 != NUM_OPERATOR_KINDS && sOperatorTable::ByKind[Kind3].NumOperands == 2
+	 && OperatorAlgebra[Kind3].Inverse == tOps::KindOf[Op])
+	{
+		Rules |= 1 << PRUNE_CANCELS_OUT;
+	}
+	return Rules;
+}
+
+template <class tOps>
+constexpr typename tPruneTable<tOps>::sRules MakePruneTable(void)
+{
+	typename tPruneTable<tOps>::sRules Table = {};
+	int Code4 = 0, Code3 = 0, Code2 = 0, Op = 0, n = 0;	// A constexpr function can't leave them uninitialized.
+
+	for (Code4 = 0; Code4 < tPruneTable<tOps>::NumCodes; Code4++)
+		for (Code3 = 0; Code3 < tPruneTable<tOps>::NumCodes; Code3++)
+			for (Code2 = 0; Code2 < tPruneTable<tOps>::NumCodes; Code2++)
+				for (Op = 0; Op < tOps::NumOperators; Op++)
+					Table.Rules[n++] = (unsigned short)PruneRulesFor<tOps>(Code4, Code3, Code2, Op);
+	return Table;
+}
+
+// A constant expression, so it's filled in when we're compiled rather than when we start.
+template <class tOps> const typename tPruneTable<tOps>::sRules tPruneTable<tOps>::Table = MakePruneTable<tOps>();
+
+template <class tOps>
+static inline int PruneCodeOf(const sItem *Items, int n)
+{
+	return n < 0 ? tPruneTable<tOps>::NoItem : Items[n].ItemType == OPERATOR ? OPERATOR + Items[n].Index : Items[n].ItemType;
+}
+
+static inline bool SameItem(const sItem *pA, const sItem *pB)
+{
+	return pA->ItemType == pB->ItemType && pA->Index == pB->Index;
+}
+
+static inline bool IsOne(const sItem *pItem)
+{
+	return pItem->ItemType == CONSTANT && pItem->Index == 0;
+}
+
+// Which rule to count it against when several rule it out, which is the first.
+static inline int FirstPruneRuleIn(unsigned int Rules)
+{
+	int Rule;
+
+	for (Rule = 0; (Rules & (1 << Rule)) == 0; Rule++)
+		;
+	return Rule;
+}
+
+// Items[NumItems-1] is an operator. Returns false if there's an equivalent formula which we check instead.
+template <class tOps>
+static inline bool CheckOperatorValidHere(const sItem *Items, int NumItems)
+{
+	const int NumCodes = tPruneTable<tOps>::NumCodes;
+	unsigned int Rules;
+
+	Rules = tPruneTable<tOps>::Table.Rules[((PruneCodeOf<tOps>(Items, NumItems - 4) * NumCodes + PruneCodeOf<tOps>(Items, NumItems - 3)) * NumCodes
+											+ PruneCodeOf<tOps>(Items, NumItems - 2)) * tOps::NumOperators + Items[NumItems - 1].Index];
+	if (Rules == 0)
+		return true;
+	// The table only has these rules if the items they look at are operands, so they're there.
+	if ((Rules & PRUNE_IF_SAME_OPERANDS) != 0 && !SameItem(&Items[NumItems - 3], &Items[NumItems - 2]))
+		Rules &= ~PRUNE_IF_SAME_OPERANDS;
+	if ((Rules & PRUNE_IF_OUT_OF_ORDER) != 0 && (Items[NumItems - 3].ItemType == Items[NumItems - 2].ItemType && Items[NumItems - 3].Index <= Items[NumItems - 2].Index))
+		Rules &= ~PRUNE_IF_OUT_OF_ORDER;
+	if ((Rules & PRUNE_IF_SAME_AROUND) != 0 && !SameItem(&Items[NumItems - 4], &Items[NumItems - 2]))
+		Rules &= ~PRUNE_IF_SAME_AROUND;
+	if ((Rules & PRUNE_IF_ONE) != 0 && !IsOne(&Items[NumItems - 2])
+	 && !(OperatorAlgebra[tOps::KindOf[Items[NumItems - 1].Index]].Commutative && NumItems >= 3 && Items[NumItems - 2].ItemType != OPERATOR && IsOne(&Items[NumItems - 3])))
+	{
+		Rules &= ~PRUNE_IF_ONE;
+	}
+	if (Rules == 0)
+		return true;
+	STAT_INC(Pruned[FirstPruneRuleIn(Rules)]);
+	return false;
+}
+
+// Whether the depth first search would look at the formula, rather than skipping it for an equivalent one.
+template <class tOps>
+static bool FormulaSearched(const sItem Items[], int NumItems)
+{
+	int inum;
+
+	for (inum = 0; inum < NumItems; inum++)
+	{
+		if (Items[inum].ItemType == OPERATOR && !CheckOperatorValidHere<tOps>(Items, inum + 1))
+			return false;
+	}
+	return true;
+}
+
+string FormulaToString(const sFormula *pFormula)
+{
+	string Str;
+	int inum;
+
+	for (inum = 0; inum < pFormula->NumItems; inum++)
+	{
+		if (inum > 0)
+			Str += " ";
+		switch (pFormula->Items[inum].ItemType)
+		{
+		case OPERATOR:
+			Str += pFormula->Operators[pFormula->Items[inum].Index]->Display;
+			break;
+		case CONSTANT:
+			Str += to_string(pFormula->Items[inum].Index + 1);
+			break;
+		case I:
+			Str += "i";
+			break;
+		case S:
+			Str += "S(i-" + to_string(pFormula->Items[inum].Index + 1) + ")";
+			break;
+		default:
+			assert(false);
+		}
+	}
+	return Str;
+}
+
+void SpitFormula(const sFormula *pFormula)
+{
+	cout << "If you can read reverse polish, each number S(i) in the series S is given by:" << endl;
+	cout << " " << FormulaToString(pFormula) << endl;
+}
+
+// Where we've got to in the tree of possible formulae. Items[0..NumItems-1] is the formula we're currently looking at.
+typedef struct {
+	sItem	Items[MAX_POSS_ITEMS_IN_EXPRESSION];
+	int		NumItems;
+	int		StackHeight;
+	bool	ItemValid;	// Whether Items[NumItems-1] can go here, with or without needing further items after it to create a valid formula.
+	unsigned char	Novelty[MAX_POSS_ITEMS_IN_EXPRESSION + 1];	// Novelty[n] is what Items[0..n-1] bring in between them which makes a formula new.
+} sSearchState;
+
+// One chunk of the search which can be handed to a worker thread: either a single formula, or a formula and the whole
+// subtree of longer formulae which start with it.
+typedef struct {
+	sSearchState	Start;
+	bool			WholeSubtree;
+} sSearchTask;
+
+// Formulae shorter than this are searched on a single thread, since it takes longer to start the threads than to search them.
+#define MIN_ITEMS_FOR_PARALLEL_SEARCH	6
+// The search is split into subtrees, one for each valid formula prefix of this many items. The subtrees are numbered in the
+// order the serial search would visit them, which is how we make sure the parallel search gives the same answer.
+#define PARALLEL_PREFIX_LEN				3
+
+// Moves on to the next formula in enumeration order, i.e. a depth-first walk of the tree of formulae.
+// Items[0..Floor-1] are never changed, so Floor > 0 restricts the walk to the subtree below those items. The walk never goes
+// deeper than MaxDepth items. Returns false when there's nothing left to walk.
+template <class tOps>
+static bool NextNode(sSearchState *pState, const sSearchLimits *pLimits, int Floor, int MaxDepth)
+{
+	sItem *Items = pState->Items;
+	bool Ready;
+
+	// Enlarge the expression.
+	if (pState->ItemValid && pState->NumItems < MaxDepth)
+	{
+		// When we want to tack another item onto the end of the string, that item will be a constant.
+		Items[pState->NumItems].ItemType = CONSTANT;
+		Items[pState->NumItems].Index = 0;
+		pState->NumItems += 1;
+		pState->StackHeight += GetStackHeightIncrease<tOps>(CONSTANT, 0);
+	}
+	else
+	{
+		for (Ready = false; !Ready; )
+		{
+			if (pState->NumItems == Floor)
+			{
+				// Already come all the way back to the floor and exhausted it, so finish.
+				return false;
+			}
+			Ready = true;
+			pState->StackHeight -= GetStackHeightIncrease<tOps>(Items[pState->NumItems - 1].ItemType, Items[pState->NumItems - 1].Index);
+			if (Items[pState->NumItems - 1].Index < pLimits->NumIndexValsForItem[Items[pState->NumItems - 1].ItemType] - 1)
+			{
+				Items[pState->NumItems - 1].Index += 1;
+			}
+			else
+			{
+				// Already at last index for this item type so go to next type.
+				if (Items[pState->NumItems - 1].ItemType < NUM_ITEM_TYPES - 1)
+				{
+					INC_TYPE(Items[pState->NumItems - 1].ItemType);
+					Items[pState->NumItems - 1].Index = 0;
+				}
+				else
+				{
+					// Already at last type so go back to previous item.
+					pState->NumItems -= 1;
+					Ready = false;
+				}
+			}
+		}
+		pState->StackHeight += GetStackHeightIncrease<tOps>(Items[pState->NumItems - 1].ItemType, Items[pState->NumItems - 1].Index);
+	}
+	// Need to set ItemValid indicating whether this item can go here, with or without needing further items after it to create a valid formula,
+	// E.g. S(i) = 1 i    is not worth checking because a valid solution would need to end up with a stack height of 1, but the 'i' is valid because
+	//                    this formula might go on to become S(i) = 1 i +
+	if (Items[pState->NumItems - 1].ItemType != OPERATOR)
+	{
+		// If just added an operand, check stack height isn't so high that we can't come down to 1 by end of expression.
+		pState->ItemValid = pState->StackHeight - (pLimits->MaxItemsInExpression - pState->NumItems) * (MAX_OP_CONSUMPTION - 1) <= 1;
+		if (!pState->ItemValid)
+		{
+			// If stack too high to take another operand, no point just trying another operand so skip them and go to the operators.
+			STAT_INC(Pruned[PRUNE_STACK_TOO_HIGH]);
+			pState->StackHeight -= GetStackHeightIncrease<tOps>(Items[pState->NumItems - 1].ItemType, Items[pState->NumItems - 1].Index);
+			Items[pState->NumItems - 1].ItemType = OPERATOR;
+			Items[pState->NumItems - 1].Index = 0;
+			pState->StackHeight += GetStackHeightIncrease<tOps>(OPERATOR, 0);
+			// Check for combinations which would be checked for at some other point.
+			pState->ItemValid = CheckOperatorValidHere<tOps>(Items, pState->NumItems);
+		}
+	}
+	else
+	{
+		// If just added an operator, check there were enough operands on the stack for it to operate on before it took them off.
+		pState->ItemValid = pState->StackHeight - GetStackHeightIncrease<tOps>(OPERATOR, Items[pState->NumItems - 1].Index) >= tOps::NumOperandsOf[Items[pState->NumItems - 1].Index];
+		if (!pState->ItemValid)
+			STAT_INC(Pruned[PRUNE_TOO_FEW_OPERANDS]);
+		pState->ItemValid = pState->ItemValid && CheckOperatorValidHere<tOps>(Items, pState->NumItems);
+	}
+	pState->Novelty[pState->NumItems] = pState->Novelty[pState->NumItems - 1] | ItemNovelty(&Items[pState->NumItems - 1], pLimits);
+	// Don't go down a subtree where none of the formulae are new. If we still need the newest S(i-k), there must be room for
+	// it and for the operators to bring the stack back down to 1 afterwards.
+	if (pLimits->NeedNewestS && (pState->Novelty[pState->NumItems] & NOVEL_S) == 0
+	 && pLimits->MaxItemsInExpression - pState->NumItems < pState->StackHeight + 1)
+	{
+		if (pState->ItemValid)
+			STAT_INC(Pruned[PRUNE_NOT_NEW]);
+		pState->ItemValid = false;
+	}
+	STAT_INC(Generated[pState->NumItems]);
+	return true;
+}
+
+// The value on top of the stack after each prefix of the formula, at every position i in the sequence. Depth d means the
+// prefix Items[0..d-1]. Rather than copying the whole stack for each prefix, Below[d] says which prefix left the value
+// underneath the top one, so adding an item to the formula costs one step per position however long the formula is.
+// Positions are evaluated a whole number of lanes at a time, and only when a formula check needs them. Since most formulae
+// are wrong at the first number they try, a prefix usually only gets evaluated for its first lanes however many formulae
+// start with it.
+typedef struct {
+	alignas(LANES_ALIGNMENT) double	Top[MAX_POSS_ITEMS_IN_EXPRESSION + 1][NUM_POSITIONS];
+	int		Below[MAX_POSS_ITEMS_IN_EXPRESSION + 1];
+	int		FirstPos[MAX_POSS_ITEMS_IN_EXPRESSION + 1];	// Positions before this are seeds, since the prefix refers back before the start of the sequence.
+	int		EndPos[MAX_POSS_ITEMS_IN_EXPRESSION + 1];	// Top[d][..EndPos[d]-1] have been evaluated from the lanes holding FirstPos[d] on.
+	uint64_t	Inexact[MAX_POSS_ITEMS_IN_EXPRESSION + 1];	// Bit i is set if anything in the prefix might have been rounded at position i
+														// (see EXACT_LIMIT). So for a whole formula, it's whether its value might have been.
+	int		NumLinked;	// Below[], FirstPos[] and EndPos[] are only up to date for the prefixes of up to this many items.
+	int		DeadDepth;	// The prefix of this many items gives nonsense, so no formula starting with it can fit. NO_DEAD_DEPTH if none.
+} sPrefixStack;
+
+#define NO_DEAD_DEPTH	(MAX_POSS_ITEMS_IN_EXPRESSION + 1)
+
+static_assert(NUM_POSITIONS <= 64, "sPrefixStack::Inexact needs a bit for every position");
+
+// Doubles hold every whole number below 2^53 exactly, so adding, subtracting, multiplying etc. whole numbers gives exactly
+// the right answer as long as it's below that too. Once a value gets this big, it and everything worked out from it might
+// have been rounded, so only the exact check (see FormulaGeneratesSequence()) can say whether the formula fits there.
+#define EXACT_LIMIT		9007199254740992.0
+
+// Works out where Items[Depth-1] leaves the stack, on top of the prefix before it, ready for it to be evaluated.
+// Nothing has been evaluated for it yet.
+template <class tOps>
+static void LinkPrefixItem(sPrefixStack *pPrefix, const sItem Items[], int Depth)
+{
+	const sItem *pItem = &Items[Depth - 1];
+
+	pPrefix->FirstPos[Depth] = pPrefix->FirstPos[Depth - 1];
+	if (pItem->ItemType != OPERATOR)
+	{
+		pPrefix->Below[Depth] = Depth - 1;
+		// Can't refer to S(i-3) if we're only 1 step into the sequence, so those positions become seeds.
+		if (pItem->ItemType == S && pPrefix->FirstPos[Depth] < pItem->Index + 1)
+			pPrefix->FirstPos[Depth] = pItem->Index + 1;
+	}
+	else if (tOps::HasUnary && tOps::NumOperandsOf[pItem->Index] == 1)
+	{
+		pPrefix->Below[Depth] = pPrefix->Below[Depth - 1];
+	}
+	else
+	{
+		pPrefix->Below[Depth] = pPrefix->Below[pPrefix->Below[Depth - 1]];
+	}
+	pPrefix->EndPos[Depth] = pPrefix->FirstPos[Depth] / NUM_LANES * NUM_LANES;
+	pPrefix->Inexact[Depth] = 0;
+}
+
+// The values on top of the stack after Items[Depth-1] in the lanes starting at position Pos. The prefix before it must already
+// have been evaluated there.
+template <class tOps>
+static inline tLanes ItemLanesAt(const sPrefixStack *pPrefix, const sItem Items[], int Depth, int Pos, const sSearchLimits *pLimits)
+{
+	const sItem *pItem = &Items[Depth - 1];
+
+	switch (pItem->ItemType)
+	{
+	case OPERATOR:
+		if (tOps::HasUnary && tOps::NumOperandsOf[pItem->Index] == 1)
+		{
+			// The pruning rules make sure an aggregate goes straight after its S(i-k) or i.
+			if (tOps::HasAggregate && OperatorAlgebra[tOps::KindOf[pItem->Index]].Aggregate)
+				return AggregateLanesAt(tOps::Is(pItem->Index, PRODUCT_OP), &Items[Depth - 2], Pos, pLimits);
+			return tOps::Apply(pItem->Index, LanesSet(0), LanesLoad(&pPrefix->Top[Depth - 1][Pos]));
+		}
+		return tOps::Apply(pItem->Index, LanesLoad(&pPrefix->Top[pPrefix->Below[Depth - 1]][Pos]), LanesLoad(&pPrefix->Top[Depth - 1][Pos]));
+	case CONSTANT:
+		return LanesSet(pItem->Index + 1);
+	case I:
+		return LanesLoad(&pLimits->Positions[Pos]);
+	case S:
+		return LanesLoadUnaligned(&pLimits->SeqLanes[NUM_POSITIONS + Pos - pItem->Index - 1]);
+	default:
+		assert(false);
+		return LanesSet(0);
+	}
+}
+
+// Makes sure that the prefixes of up to Depth items, which must all be linked, have been evaluated at positions up to EndPos-1.
+// EndPos must be a whole number of lanes.
+// Returns false, and sets DeadDepth, if one of them gives a nonsense value (division by zero, overflow etc.) at a position
+// which can never be a seed, and where nothing before it might have been rounded.
+template <class tOps>
+static bool EvaluatePrefix(sPrefixStack *pPrefix, const sItem Items[], int Depth, int EndPos, const sSearchLimits *pLimits)
+{
+	tLanes Value;
+	unsigned int Exact, Live;
+	int d, Pos;
+
+	// The shorter prefixes have always been evaluated at least as far as the longer ones, so find where to start.
+	for (d = Depth; d > 0 && pPrefix->EndPos[d] < EndPos; d--)
+		;
+	for (d++; d <= Depth; d++)
+	{
+		for (Pos = pPrefix->EndPos[d]; Pos < EndPos; Pos += NUM_LANES)
+		{
+			Value = ItemLanesAt<tOps>(pPrefix, Items, d, Pos, pLimits);
+			LanesStore(&pPrefix->Top[d][Pos], Value);
+			pPrefix->Inexact[d] |= pPrefix->Inexact[d - 1];
+			// The leaves are all small whole numbers, so it's only operators which can get too big, or give nonsense (which
+			// isn't within any limit either).
+			if (Items[d - 1].ItemType == OPERATOR && (Exact = LanesWithin(Value, EXACT_LIMIT)) != ALL_LANES)
+			{
+				pPrefix->Inexact[d] |= (uint64_t)(~Exact & ALL_LANES) << Pos;
+				// A later S(i-k) could still turn the early positions into seeds, but not the ones from MaxRetroS on.
+				Live = LanesBetween(Pos, max(pPrefix->FirstPos[d], pLimits->NumIndexValsForItem[S]), pLimits->SeqLen + 1)
+					 & ~(unsigned int)(pPrefix->Inexact[d - 1] >> Pos);
+				if ((LanesFinite(Value) & Live) != Live)
+				{
+					pPrefix->DeadDepth = d;
+					return false;
+				}
+			}
+		}
+		pPrefix->EndPos[d] = EndPos;
+	}
+	return true;
+}
+
+// Checks whether the formula Items[0..Depth-1] generates the user's sequence, evaluating it (and its prefixes) only as far
+// as it takes to find out. We also make sure it gives a sensible next number. Where it might have been rounded, it passes,
+// whatever it came out as, and it's up to the exact check.
+template <class tOps>
+static bool FormulaFitsSequence(sPrefixStack *pPrefix, const sItem Items[], int Depth, const sSearchLimits *pLimits)
+{
+	unsigned int Wrong;
+	int d, Pos;
+
+	STAT_INC(Evaluated);
+	for (d = pPrefix->NumLinked + 1; d <= Depth; d++)
+		LinkPrefixItem<tOps>(pPrefix, Items, d);
+	pPrefix->NumLinked = Depth;
+	// We go up to position SeqLen, i.e. 1 more than you might expect, because that last position is the next number in the
+	// sequence after the numbers the user provided.
+	for (Pos = pPrefix->FirstPos[Depth] / NUM_LANES * NUM_LANES; Pos <= pLimits->SeqLen; Pos += NUM_LANES)
+	{
+		if (!EvaluatePrefix<tOps>(pPrefix, Items, Depth, Pos + NUM_LANES, pLimits))
+		{
+			STAT_INC(FailedNonsense);
+			return false;
+		}
+		Wrong = LanesBetween(Pos, pPrefix->FirstPos[Depth], pLimits->SeqLen)
+			  & ~LanesEqual(LanesLoad(&pPrefix->Top[Depth][Pos]), LanesLoad(&pLimits->SeqLanes[NUM_POSITIONS + Pos]))
+			  & ~(unsigned int)(pPrefix->Inexact[Depth] >> Pos);
+		if (Wrong != 0)
+		{
+			// This formula failed to generate the correct number for one of the numbers in the sequence.
+			STAT_INC(FailedAt[Pos + LowestLane(Wrong)]);
+			return false;
+		}
+	}
+	return true;
+}
+
+// Copies where a depth first search task has got to into the solve's checkpoint.
+static void SaveTaskState(sSolveWatch *pWatch, int TaskNum, const sSearchState *pState)
+{
+	lock_guard<mutex> Guard(pWatch->CheckpointLock);
+	sTaskCheckpoint *pTask = &pWatch->Checkpoint.Tasks[TaskNum];
+
+	pTask->Status = TASK_STARTED;
+	memcpy(pTask->Items, pState->Items, pState->NumItems * sizeof(pState->Items[0]));
+	pTask->NumItems = pState->NumItems;
+	pTask->StackHeight = pState->StackHeight;
+	pTask->ItemValid = pState->ItemValid;
+}
+
+static void SaveTaskDone(sSolveWatch *pWatch, int TaskNum)
+{
+	lock_guard<mutex> Guard(pWatch->CheckpointLock);
+
+	pWatch->Checkpoint.Tasks[TaskNum].Status = TASK_DONE;
+}
+
+static void SaveTaskFound(sSolveWatch *pWatch, int TaskNum, const sFormula *pFound)
+{
+	lock_guard<mutex> Guard(pWatch->CheckpointLock);
+
+	pWatch->Checkpoint.Tasks[TaskNum].Status = TASK_DONE;
+	if (pWatch->Checkpoint.FoundTask < 0 || TaskNum < pWatch->Checkpoint.FoundTask)
+	{
+		pWatch->Checkpoint.FoundTask = TaskNum;
+		pWatch->Checkpoint.Found = *pFound;
+	}
+}
+
+// Puts a task which starts at *pState back where the checkpoint says it had got to. Returns false, leaving it where it
+// starts, if the checkpoint can't be for that task.
+static bool RestoreTaskState(sSearchState *pState, const sTaskCheckpoint *pTask, const sSearchLimits *pLimits)
+{
+	int n;
+
+	if (pTask->NumItems < pState->NumItems || pTask->NumItems > pLimits->MaxItemsInExpression)
+		return false;
+	for (n = 0; n < pState->NumItems; n++)
+	{
+		if (!SameItem(&pTask->Items[n], &pState->Items[n]))
+			return false;
+	}
+	memcpy(pState->Items, pTask->Items, pTask->NumItems * sizeof(pTask->Items[0]));
+	pState->NumItems = pTask->NumItems;
+	pState->StackHeight = pTask->StackHeight;
+	pState->ItemValid = pTask->ItemValid;
+	for (n = 0; n < pState->NumItems; n++)
+		pState->Novelty[n + 1] = pState->Novelty[n] | ItemNovelty(&pState->Items[n], pLimits);
+	return true;
+}
+
+// Searches the formula in *pState and, if WholeSubtree, all the longer formulae which start with it, in enumeration order,
+// never changing Items[0..Floor-1]. If Resumed, *pState is where the task had got to before (see sTaskCheckpoint), so it
+// starts with the formula after that. Stops at the first formula which fits the sequence. Also stops, unsuccessfully, if
+// some earlier task finds a fit first, since our answer would be thrown away anyway, or if the whole solve has to stop.
+// Adds how many formulae it turned down to *pRejected.
+template <class tOps>
+static bool SearchTask(sSearchState *pState, int Floor, bool WholeSubtree, bool Resumed, const sSearchLimits *pLimits, int TaskNum, const atomic<int> *pFirstTaskFound, unsigned long long *pRejected, sFormula *pFound)
+{
+	sPrefixStack Prefix;
+	unsigned int NodeCount = 0;
+
+	Prefix.FirstPos[0] = 0;
+	Prefix.EndPos[0] = NUM_POSITIONS;
+	Prefix.Inexact[0] = 0;
+	Prefix.NumLinked = 0;
+	Prefix.DeadDepth = NO_DEAD_DEPTH;
+	if (Resumed && !NextNode<tOps>(pState, pLimits, Floor, pLimits->MaxItemsInExpression))
+		return false;
+	do
+	{
+		// NextNode() only ever changes the last item, so whatever we knew about the prefixes which include it is out of date.
+		if (pState->NumItems > 0 && pState->NumItems <= Prefix.NumLinked)
+			Prefix.NumLinked = pState->NumItems - 1;
+		// Nothing below a prefix which gives nonsense can fit, so don't check it or go any deeper.
+		if (pState->NumItems > Prefix.DeadDepth)
+		{
+			if (pState->ItemValid)
+				STAT_INC(Pruned[PRUNE_NONSENSE]);
+			pState->ItemValid = false;
+		}
+		else
+			Prefix.DeadDepth = NO_DEAD_DEPTH;
+		if (pState->ItemValid && pState->StackHeight == 1 && FormulaIsNew(pState->Novelty[pState->NumItems], pState->NumItems, pLimits))
+		{
+			// This might now equal S(i). Check it's true for all i, quickly with doubles and then, if it is, exactly.
+			if (FormulaFitsSequence<tOps>(&Prefix, pState->Items, pState->NumItems, pLimits))
+			{
+				memcpy(pFound->Items, pState->Items, pState->NumItems * sizeof(pState->Items[0]));
+				pFound->NumItems = pState->NumItems;
+				pFound->Operators = tOps::Operators;
+				if (FormulaGeneratesSequence(pFound, pLimits->pSeq, pLimits->SeqLen))
+					return true;
+			}
+			else
+				(*pRejected)++;
+			if (Prefix.DeadDepth <= pState->NumItems)
+				pState->ItemValid = false;
+		}
+		// Don't look at the atomic too often since other threads keep it hot.
+		if ((++NodeCount & 0xFFF) == 0)
+		{
+			// We've finished with this formula, so it's where to carry on from after it.
+			if (pLimits->pWatch != nullptr && pLimits->pWatch->Checkpoints)
+				SaveTaskState(pLimits->pWatch, TaskNum, pState);
+			if (pFirstTaskFound->load(memory_order_relaxed) < TaskNum || SearchStopped(pLimits->pWatch))
+				return false;
+		}
+	} while (WholeSubtree && NextNode<tOps>(pState, pLimits, Floor, pLimits->MaxItemsInExpression));
+	return false;
+}
+
+// Searches for a formula which fits the sequence using the operators in tOps, by walking the tree of formulae depth first.
+// Only searches this shard's run of the tasks, carrying on from pLimits->pResume if there is one, and says which task found
+// the formula in *pFoundTask.
+template <class tOps>
+static bool DepthFirstSearch(const sSearchLimits *pLimits, int NumThreads, int *pFoundTask, sFormula *pFound)
+{
+	sSearchState State;
+	vector<sSearchTask> Tasks;
+	vector<sFormula> Found;
+	vector<unsigned long long> Rejected(NumThreads, 0);	// By each thread, for sSolver::Rejections.
+	atomic<int> FirstTaskFound;
+	sSolveWatch *pWatch = pLimits->pWatch;
+	const sSearchCheckpoint *pResume = pLimits->pResume;
+	int NumTasks, FirstTask, EndTask, ThreadNum;
+
+	State.NumItems = 0;
+	State.StackHeight = 0;
+	State.ItemValid = true;
+	State.Novelty[0] = 0;
+
+	if (pLimits->MaxItemsInExpression < MIN_ITEMS_FOR_PARALLEL_SEARCH)
+	{
+		Tasks.push_back({ State, true });
+	}
+	else
+	{
+		// Walk the tree down to the prefix length, making a task for each valid prefix. The short formulae on the way down
+		// have to be checked too, so they get tasks of their own, in the order the serial search would have checked them.
+		while (NextNode<tOps>(&State, pLimits, 0, PARALLEL_PREFIX_LEN))
+		{
+			if (!State.ItemValid)
+				continue;
+			if (State.NumItems == PARALLEL_PREFIX_LEN)
+				Tasks.push_back({ State, true });
+			else if (State.StackHeight == 1)
+				Tasks.push_back({ State, false });
+		}
+	}
+
+	// We want the fit which the serial search would have found, i.e. the one in the lowest-numbered task.
+	NumTasks = (int)Tasks.size();
+	// Rounded up, so the first shard gets the task when there's only one.
+	FirstTask = (int)(((long long)NumTasks * pLimits->Shard + pLimits->NumShards - 1) / pLimits->NumShards);
+	EndTask = (int)(((long long)NumTasks * (pLimits->Shard + 1) + pLimits->NumShards - 1) / pLimits->NumShards);
+	// A checkpoint with a different number of tasks can't have been made by this search.
+	if (pResume != nullptr && (int)pResume->Tasks.size() != NumTasks)
+		pResume = nullptr;
+	Found.resize(NumTasks);
+	FirstTaskFound = NumTasks;
+	if (pResume != nullptr && pResume->FoundTask >= 0 && pResume->FoundTask < NumTasks)
+	{
+		FirstTaskFound = pResume->FoundTask;
+		Found[pResume->FoundTask] = pResume->Found;
+	}
+	// The tasks are how we say how far through we are, and where we've got to.
+	if (pWatch != nullptr)
+	{
+		pWatch->UnitsDone = 0;
+		pWatch->NumUnits = EndTask - FirstTask;
+	}
+	if (pWatch != nullptr && pWatch->Checkpoints)
+	{
+		lock_guard<mutex> Guard(pWatch->CheckpointLock);
+
+		if (pResume != nullptr)
+		{
+			pWatch->Checkpoint.Tasks = pResume->Tasks;
+			pWatch->Checkpoint.FoundTask = FirstTaskFound.load() < NumTasks ? FirstTaskFound.load() : -1;
+			pWatch->Checkpoint.Found = pResume->Found;
+		}
+		else
+		{
+			pWatch->Checkpoint.Tasks.assign(NumTasks, sTaskCheckpoint());
+			for (sTaskCheckpoint& Task : pWatch->Checkpoint.Tasks)
+				Task.Status = TASK_NOT_STARTED;
+		}
+	}
+	RunTasksWorkStealing(NumTasks, NumThreads, [&](int TaskNum, int ThreadNum)
+	{
+		sSearchState TaskState = Tasks[TaskNum].Start;
+		bool Resumed = false;
+		int Lowest;
+
+		if (TaskNum < FirstTask || TaskNum >= EndTask)
+			return;
+		if (FirstTaskFound.load() < TaskNum || (pWatch != nullptr && pWatch->Stopped.load()))
+			return;
+		if (pResume != nullptr && pResume->Tasks[TaskNum].Status != TASK_NOT_STARTED)
+		{
+			if (pResume->Tasks[TaskNum].Status == TASK_DONE)
+			{
+				if (pWatch != nullptr)
+					pWatch->UnitsDone++;
+				return;
+			}
+			Resumed = RestoreTaskState(&TaskState, &pResume->Tasks[TaskNum], pLimits);
+		}
+		if (SearchTask<tOps>(&TaskState, Tasks[TaskNum].Start.NumItems, Tasks[TaskNum].WholeSubtree, Resumed, pLimits, TaskNum, &FirstTaskFound, &Rejected[ThreadNum], &Found[TaskNum]))
+		{
+			for (Lowest = FirstTaskFound.load(); TaskNum < Lowest && !FirstTaskFound.compare_exchange_weak(Lowest, TaskNum); )
+				;
+			if (pWatch != nullptr && pWatch->Checkpoints)
+				SaveTaskFound(pWatch, TaskNum, &Found[TaskNum]);
+		}
+		else if (pWatch != nullptr && pWatch->Checkpoints && !pWatch->Stopped.load() && FirstTaskFound.load() > TaskNum)
+		{
+			SaveTaskDone(pWatch, TaskNum);
+		}
+		if (pWatch != nullptr)
+			pWatch->UnitsDone++;
+	});
+	for (ThreadNum = 0; ThreadNum < NumThreads; ThreadNum++)
+		pLimits->pRejections->Rejected += Rejected[ThreadNum];
+	if (FirstTaskFound.load() == NumTasks)
+	{
+		return false;
+	}
+	*pFoundTask = FirstTaskFound.load();
+	*pFound = Found[FirstTaskFound.load()];
+	return true;
+}
+
+// Searches for a formula which fits the sequence using the operators in tOps. pLimits is filled in apart from the operators.
+template <class tOps>
+static bool SearchAttempt(sSearchLimits *pLimits, eSearchEngine Engine, int NumThreads, sFormula *pFound)
+{
+	eBottomUpResult Result;
+	bool Found;
+
+	pLimits->NumIndexValsForItem[OPERATOR] = tOps::NumOperators;
+	pLimits->FoundTask = -1;
+	// The bottom-up search can't be shared out, since its answers don't come in the depth first search's order.
+	if (Engine == BOTTOM_UP_ENGINE && pLimits->NumShards == 1 && (Result = BottomUpSearch<tOps>(pLimits, BOTTOM_UP_MAX_BYTES, pFound)) != BOTTOM_UP_INCOMPLETE)
+		Found = Result == BOTTOM_UP_FOUND;
+	else
+		Found = DepthFirstSearch<tOps>(pLimits, NumThreads, &pLimits->FoundTask, pFound);	// Only this can say there's nothing to find if the bottom-up search ran out of memory.
+	if (Found)
+		pFound->Operators = tOps::Operators;
+	return Found;
+}
+
+// Searches for a formula made of two halves which fits the sequence, using the operators in tOps, whichever engine was asked
+// for, since neither of them could get through formulae this long. It only uses one thread. The engine and thread count
+// are only there so that it fits in Attempts[] alongside SearchAttempt().
+template <class tOps>
+static bool MeetInTheMiddleAttempt(sSearchLimits *pLimits, eSearchEngine, int, sFormula *pFound)
+{
+	pLimits->NumIndexValsForItem[OPERATOR] = tOps::NumOperators;
+	pLimits->FoundTask = -1;
+	// It isn't split into tasks, so the first shard does all of it.
+	if (pLimits->Shard != 0)
+		return false;
+	return MeetInTheMiddleSearch<tOps>(pLimits, BOTTOM_UP_MAX_BYTES, pFound) == BOTTOM_UP_FOUND;
+}
+
+// GuessSequence(), which gives up if pWatch (nullptr for never) says so, only does the solver's shard, carries on from
+// pResume (nullptr for the start) and says which task found the formula.
+static bool SearchStep(sSolver *pSolver,
+						int Seq[], int SeqLen,	int Attempt,
+												int MaxRetroS,				// How far back in the sequence you look. MaxRetroS == x means back as far as S(i-x).
+												sSolveWatch *pWatch,
+												const sSearchCheckpoint *pResume,
+												int *pFoundTask,
+												sFormula *pFound)
+{
+	sSearchLimits Limits;
+	bool Found;
+	int i;
+
+	assert(Attempts[Attempt].MaxItemsInExpression <= MAX_POSS_ITEMS_IN_EXPRESSION);
+
+	// If there's a formula with no S(i-k) which fits, it might be in the library, which is far quicker than searching.
+	*pFoundTask = -1;
+	if (MaxRetroS == 0 && pSolver->Shard == 0 && LookUpFormula(pSolver->pLibrary, Seq, SeqLen, Attempt, Attempts[Attempt].MaxItemsInExpression, pFound))
+		return true;
+
+	for (i = 0; i < NUM_POSITIONS; i++)
+	{
+		Limits.SeqLanes[i] = 1;
+		Limits.SeqLanes[NUM_POSITIONS + i] = i < SeqLen ? Seq[i] : 1;
+		Limits.Positions[i] = i;
+	}
+	FillRunningTotals(&Limits);
+	Limits.pSeq = Seq;
+	Limits.SeqLen = SeqLen;
+	Limits.MaxItemsInExpression = Attempts[Attempt].MaxItemsInExpression;
+	Limits.NumIndexValsForItem[CONSTANT] = 9;				// Need all constants 1-9. 0 is never needed in formulas.
+	Limits.NumIndexValsForItem[S] = max(MaxRetroS, 1);		// See block comment above. NextNode() always tries S(i-1) anyway.
+	Limits.NumIndexValsForItem[I] = 0;						// Index not used.
+	// Everything without the newest S(i-k) was looked at with the MaxRetroS before, and everything this attempt has in common
+	// with the one before was looked at by that one.
+	Limits.NeedNewestS = MaxRetroS > 1;
+	Limits.NumOldOperators = Attempt > 0 ? Attempts[Attempt - 1].NumOperators : 0;
+	Limits.OldMaxItems = Attempt > 0 ? Attempts[Attempt - 1].MaxItemsInExpression : 0;
+	Limits.pWatch = pWatch;
+	Limits.pRejections = &pSolver->Rejections;
+	Limits.Shard = pSolver->Shard;
+	Limits.NumShards = pSolver->NumShards;
+	Limits.pResume = pResume;
+	STAT_TIMER_START(StartTime);
+	Found = Attempts[Attempt].pSearch(&Limits, pSolver->Engine, pSolver->NumThreads, pFound);
+	STAT_TIMER_ADD(StartTime, AttemptNs[Attempt]);
+	STAT_INC(AttemptSearches[Attempt]);
+	*pFoundTask = Limits.FoundTask;
+	return Found;
+}
+
+bool GuessSequence(sSolver *pSolver, int Seq[], int SeqLen, int Attempt, int MaxRetroS, sFormula *pFound)
+{
+	int FoundTask;
+
+	return SearchStep(pSolver, Seq, SeqLen, Attempt, MaxRetroS, nullptr, nullptr, &FoundTask, pFound);
+}
+
+bool SearchStopped(sSolveWatch *pWatch)
+{
+	const sSolveControl *pControl;
+	long long ElapsedNs, DueNs;
+
+	if (pWatch == nullptr)
+		return false;
+	if (pWatch->Stopped.load(memory_order_relaxed))
+		return true;
+	pControl = pWatch->pControl;
+	ElapsedNs = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - pWatch->StartTime).count();
+	if ((pControl->pCancel != nullptr && pControl->pCancel->load()) || (pControl->TimeLimitMs > 0 && ElapsedNs >= pControl->TimeLimitMs * 1e6))
+	{
+		pWatch->Stopped = true;
+		return true;
+	}
+	// Whichever thread gets there first tells them, and the others carry on searching.
+	DueNs = pWatch->NextProgressNs.load(memory_order_relaxed);
+	if (pControl->OnProgress && ElapsedNs >= DueNs
+	 && pWatch->NextProgressNs.compare_exchange_strong(DueNs, ElapsedNs + (long long)(pControl->ProgressIntervalMs * 1e6)))
+	{
+		lock_guard<mutex> Guard(pWatch->ProgressLock);
+
+		pWatch->Progress.Fraction = pWatch->NumUnits > 0 ? min(1.0, (double)pWatch->UnitsDone.load() / pWatch->NumUnits) : 0;
+		pWatch->Progress.ElapsedMs = ElapsedNs / 1e6;
+		pControl->OnProgress(pWatch->Progress);
+	}
+	DueNs = pWatch->NextCheckpointNs.load(memory_order_relaxed);
+	if (pWatch->Checkpoints && ElapsedNs >= DueNs
+	 && pWatch->NextCheckpointNs.compare_exchange_strong(DueNs, ElapsedNs + (long long)(pControl->CheckpointIntervalMs * 1e6)))
+	{
+		lock_guard<mutex> Guard(pWatch->CheckpointLock);
+
+		pControl->OnCheckpoint(pWatch->Checkpoint);
+	}
+	return false;
+}
+
+void FillRunningTotals(sSearchLimits *pLimits)
+{
+	int i;
+
+	// The padding in front is 1s, like SeqLanes[].
+	for (i = 0; i < NUM_POSITIONS; i++)
+		pLimits->SeqSums[i] = pLimits->SeqProducts[i] = 1;
+	pLimits->SeqSums[NUM_POSITIONS] = pLimits->SeqProducts[NUM_POSITIONS] = pLimits->SeqLanes[NUM_POSITIONS];
+	pLimits->PositionSums[0] = 0;
+	pLimits->PositionProducts[0] = 1;	// 0! is 1, so i is left out of "i prod" at position 0.
+	for (i = 1; i < NUM_POSITIONS; i++)
+	{
+		pLimits->SeqSums[NUM_POSITIONS + i] = pLimits->SeqSums[NUM_POSITIONS + i - 1] + pLimits->SeqLanes[NUM_POSITIONS + i];
+		pLimits->SeqProducts[NUM_POSITIONS + i] = pLimits->SeqProducts[NUM_POSITIONS + i - 1] * pLimits->SeqLanes[NUM_POSITIONS + i];
+		pLimits->PositionSums[i] = pLimits->PositionSums[i - 1] + pLimits->Positions[i];
+		pLimits->PositionProducts[i] = pLimits->PositionProducts[i - 1] * pLimits->Positions[i];
+	}
+}
+
+// The number of seeds the formula needs, i.e. how far back it looks.
+static int CountSeeds(const sFormula *pFormula)
+{
+	int inum, NumSeeds = 0;
+
+	for (inum = 0; inum < pFormula->NumItems; inum++)
+	{
+		if (pFormula->Items[inum].ItemType == S && pFormula->Items[inum].Index + 1 > NumSeeds)
+			NumSeeds = pFormula->Items[inum].Index + 1;
+	}
+	return NumSeeds;
+}
+
+void InitSolver(sSolver *pSolver, eSearchEngine Engine, int NumThreads)
+{
+	pSolver->Engine = Engine;
+	pSolver->NumThreads = NumThreads;
+	pSolver->pLibrary = nullptr;
+	pSolver->ClosedForms = true;
+	pSolver->Shard = 0;
+	pSolver->NumShards = 1;
+	pSolver->PortfolioSize = 1;
+	pSolver->Rejections.Rejected = 0;
+}
+
+bool SolveSequence(sSolver *pSolver, int Seq[], int SeqLen, bool ShowProgress, const sSolveControl *pControl, sSolveResult *pResult)
+{
+	pResult->Attempt = -1;
+	pResult->MaxRetroS = -1;
+	return ResumeSolveSequence(pSolver, Seq, SeqLen, 0, 0, ShowProgress, pControl, pResult);
+}
+
+// Changes MaxRetroS and Attempt to the step ResumeSolveSequence() searches before them, or -1s if they're the first.
+static void StepBefore(int *pMaxRetroS, int *pAttempt)
+{
+	if (*pAttempt > 0)
+	{
+		(*pAttempt)--;
+	}
+	else if (*pMaxRetroS == 0)
+	{
+		*pMaxRetroS = -1;
+		*pAttempt = -1;
+	}
+	else
+	{
+		// There's no step with MaxRetroS 1.
+		*pMaxRetroS = *pMaxRetroS == 2 ? 0 : *pMaxRetroS - 1;
+		*pAttempt = NUM_ATTEMPTS - 1;
+	}
+}
+
+// The linear recurrence with the fewest seeds which fits the sequence (see ClosedForm.h), and the step it's taken at
+// instead of being searched for: the one which looks back as far as it does, at the first attempt which could find it.
+typedef struct {
+	bool		Found;
+	int			MaxRetroS;
+	int			Attempt;
+	sFormula	Formula;
+} sRecurrenceStep;
+
+static void FindRecurrence(const sSolver *pSolver, const int Seq[], int SeqLen, sRecurrenceStep *pRecurrence)
+{
+	int Order;
+
+	pRecurrence->Found = false;
+	for (Order = 1; pSolver->ClosedForms && !pRecurrence->Found && Order < SeqLen - 2; Order++)
+	{
+		if (SolveRecurrence(Seq, SeqLen, Order, &pRecurrence->Formula, &pRecurrence->Attempt))
+		{
+			pRecurrence->Found = true;
+			// There's no step with MaxRetroS 1, since S(i-1) is always allowed.
+			pRecurrence->MaxRetroS = Order == 1 ? 0 : Order;
+		}
+	}
+}
+
+// A formula with fewer seeds than the recurrence would still be the answer, but only if it's no longer than the recurrence,
+// i.e. if an attempt up to the recurrence's finds it, so the later attempts of the steps before the recurrence's are skipped.
+// That's what makes a recurrence quick: e.g. Fibonacci only has the first attempt with MaxRetroS 0 searched before it,
+// rather than all of them, which would take a minute or so.
+static bool StepSkipped(const sRecurrenceStep *pRecurrence, int MaxRetroS, int Attempt)
+{
+	return pRecurrence->Found && MaxRetroS < pRecurrence->MaxRetroS && Attempt > pRecurrence->Attempt;
+}
+
+static bool IsRecurrenceStep(const sRecurrenceStep *pRecurrence, int MaxRetroS, int Attempt)
+{
+	return pRecurrence->Found && MaxRetroS == pRecurrence->MaxRetroS && Attempt == pRecurrence->Attempt;
+}
+
+static void TakeRecurrence(const sRecurrenceStep *pRecurrence, sSolveResult *pResult)
+{
+	pResult->Success = true;
+	pResult->ClosedForm = true;
+	pResult->Formula = pRecurrence->Formula;
+	pResult->NumSeeds = CountSeeds(&pResult->Formula);
+	pResult->MaxRetroS = pRecurrence->MaxRetroS;
+	pResult->Attempt = pRecurrence->Attempt;
+	pResult->Task = -1;
+}
+
+// A solve which was stopped without a formula has searched the steps before the one it stopped in, but if it skipped any of
+// them for the recurrence, a longer sequence which the recurrence doesn't fit would still have to search those, so it
+// only counts as having got as far as the first one it skipped. FirstSkipped is (-1, -1) if it didn't skip any.
+static void StoppedBefore(int MaxRetroS, int Attempt, pair<int, int> FirstSkipped, sSolveResult *pResult)
+{
+	if (FirstSkipped.first >= 0)
+	{
+		MaxRetroS = FirstSkipped.first;
+		Attempt = FirstSkipped.second;
+	}
+	StepBefore(&MaxRetroS, &Attempt);
+	pResult->MaxRetroS = MaxRetroS;
+	pResult->Attempt = Attempt;
+}
+
+// One of the steps a portfolio solve searches alongside the others (see sSolver::PortfolioSize).
+typedef struct {
+	int			MaxRetroS;
+	int			Attempt;
+	sSolveWatch	Watch;		// Its own, so that it can be stopped without stopping the steps before it.
+	bool		Searched;	// It wasn't stopped, so it's been searched all the way through, or up to its formula.
+	bool		Found;
+	int			Task;
+	sFormula	Formula;
+} sPortfolioStep;
+
+// SolveFrom()'s steps, PortfolioSize of them at a time, with the result the same as searching them one after another.
+static void SolvePortfolio(sSolver *pSolver, int Seq[], int SeqLen, int FromMaxRetroS, int FromAttempt, const sRecurrenceStep *pRecurrence, bool ShowProgress,
+							const sSolveControl *pControl, chrono::steady_clock::time_point StartTime, sSolveResult *pResult)
+{
+	sSolveControl StepControl = pControl != nullptr ? *pControl : sSolveControl();
+	vector<pair<int, int>> Order;
+	pair<int, int> FirstSkipped(-1, -1);
+	vector<thread> Workers;
+	vector<sSolver> Solvers;
+	atomic<int> NextStep(0), FirstFound;
+	int a, s, w, MaxRetroS, NumSteps, NumWorkers, NumBeforeSkipped = -1;
+	bool ReachesRecurrence = false;
+
+	// The steps up to the recurrence's, without the ones it skips, and then the recurrence is the answer if they find nothing.
+	for (MaxRetroS = FromMaxRetroS; !ReachesRecurrence && MaxRetroS < SeqLen - 2; MaxRetroS++)
+	{
+		if (MaxRetroS == 1)
+			continue;
+		for (a = MaxRetroS == FromMaxRetroS ? FromAttempt : 0; !ReachesRecurrence && a < NUM_ATTEMPTS; a++)
+		{
+			if (StepSkipped(pRecurrence, MaxRetroS, a))
+			{
+				if (FirstSkipped.first < 0)
+				{
+					FirstSkipped = make_pair(MaxRetroS, a);
+					NumBeforeSkipped = (int)Order.size();
+				}
+			}
+			else if (IsRecurrenceStep(pRecurrence, MaxRetroS, a))
+				ReachesRecurrence = true;
+			else
+				Order.push_back(make_pair(MaxRetroS, a));
+		}
+	}
+	NumSteps = (int)Order.size();
+	if (NumSteps == 0 && !ReachesRecurrence)
+		return;
+	vector<sPortfolioStep> Steps(NumSteps);
+	FirstFound = NumSteps;
+
+	// With several steps on the go there's no one step to say it's on.
+	StepControl.OnProgress = nullptr;
+	StepControl.OnCheckpoint = nullptr;
+	for (s = 0; s < NumSteps; s++)
+	{
+		Steps[s].MaxRetroS = Order[s].first;
+		Steps[s].Attempt = Order[s].second;
+		Steps[s].Watch.pControl = &StepControl;
+		Steps[s].Watch.StartTime = StartTime;
+		Steps[s].Watch.Stopped = false;
+		Steps[s].Watch.NextProgressNs = 0;
+		Steps[s].Watch.UnitsDone = 0;
+		Steps[s].Watch.NumUnits = 0;
+		Steps[s].Watch.Checkpoints = false;
+		Steps[s].Watch.NextCheckpointNs = 0;
+		Steps[s].Searched = false;
+		Steps[s].Found = false;
+		Steps[s].Task = -1;
+	}
+	// Share the threads out between the steps, like batch mode does between its workers.
+	NumWorkers = min(pSolver->PortfolioSize, NumSteps);
+	Solvers.assign(NumWorkers, *pSolver);
+	for (w = 0; w < NumWorkers; w++)
+	{
+		Solvers[w].NumThreads = max(pSolver->NumThreads / NumWorkers, 1);
+		Solvers[w].Rejections.Rejected = 0;
+	}
+
+	for (w = 0; w < NumWorkers; w++)
+	{
+		Workers.emplace_back([&, w]()
+		{
+			sPortfolioStep *pStep;
+			int Step, Lowest, Later;
+
+			// The steps are handed out in order, and there's no point starting one after a step which has found a formula.
+			while ((Step = NextStep++) < NumSteps && Step < FirstFound.load())
+			{
+				pStep = &Steps[Step];
+				if (!SearchStopped(&pStep->Watch) && SearchStep(&Solvers[w], Seq, SeqLen, pStep->Attempt, pStep->MaxRetroS, &pStep->Watch, nullptr, &pStep->Task, &pStep->Formula))
+				{
+					pStep->Found = true;
+					Lowest = FirstFound.load();
+					while (Step < Lowest && !FirstFound.compare_exchange_weak(Lowest, Step))
+						;
+					// Nothing after it can be the answer now, but the steps before it still have to be searched.
+					for (Later = Step + 1; Later < NumSteps; Later++)
+						Steps[Later].Watch.Stopped = true;
+				}
+				pStep->Searched = !pStep->Watch.Stopped;
+			}
+		});
+	}
+	for (thread& Worker : Workers)
+		Worker.join();
+	for (w = 0; w < NumWorkers; w++)
+		pSolver->Rejections.Rejected += Solvers[w].Rejections.Rejected;
+
+	// The answer is the first step's formula, as long as every step before it was searched all the way through. The ones
+	// after a formula which were stopped early were only stopped because of it.
+	for (s = 0; s < NumSteps; s++)
+	{
+		pResult->MaxRetroS = Steps[s].MaxRetroS;
+		pResult->Attempt = Steps[s].Attempt;
+		if (Steps[s].Found)
+		{
+			pResult->Success = true;
+			pResult->Stopped = !Steps[s].Searched;
+			pResult->Formula = Steps[s].Formula;
+			pResult->Task = Steps[s].Task;
+			pResult->NumSeeds = CountSeeds(&pResult->Formula);
+			break;
+		}
+		if (!Steps[s].Searched)
+		{
+			pResult->Stopped = true;
+			StoppedBefore(Steps[s].MaxRetroS, Steps[s].Attempt, s >= NumBeforeSkipped ? FirstSkipped : make_pair(-1, -1), pResult);
+			break;
+		}
+		if (ShowProgress)
+			cout << "Hmm...";
+	}
+	if (s == NumSteps && ReachesRecurrence)
+		TakeRecurrence(pRecurrence, pResult);
+}
+
+// ResumeSolveSequence(), with the first step's depth first search carrying on from pCheckpoint if it's for that step.
+static bool SolveFrom(sSolver *pSolver, int Seq[], int SeqLen, int FromMaxRetroS, int FromAttempt, const sSearchCheckpoint *pCheckpoint, bool ShowProgress, const sSolveControl *pControl, sSolveResult *pResult)
+{
+	chrono::steady_clock::time_point StartTime = chrono::steady_clock::now();
+	sSolveWatch Watch, *pWatch;
+	const sSearchCheckpoint *pResume;
+	sRecurrenceStep Recurrence = sRecurrenceStep();
+	pair<int, int> FirstSkipped(-1, -1);
+	int a, MaxRetroS;
+
+	for (a = 1; a < NUM_ATTEMPTS; a++)
+	{
+		assert(Attempts[a].NumOperators >= Attempts[a - 1].NumOperators && Attempts[a].MaxItemsInExpression >= Attempts[a - 1].MaxItemsInExpression);
+		assert(memcmp(Attempts[a].Operators, Attempts[a - 1].Operators, Attempts[a - 1].NumOperators * sizeof(Attempts[a].Operators[0])) == 0);
+	}
+
+	// Nothing has to keep looking at the clock if there's no control.
+	pWatch = pControl != nullptr ? &Watch : nullptr;
+	Watch.pControl = pControl;
+	Watch.StartTime = StartTime;
+	Watch.Stopped = false;
+	Watch.NextProgressNs = pControl != nullptr ? (long long)(pControl->ProgressIntervalMs * 1e6) : 0;
+	Watch.Checkpoints = pControl != nullptr && pControl->OnCheckpoint;
+	Watch.NextCheckpointNs = pControl != nullptr ? (long long)(pControl->CheckpointIntervalMs * 1e6) : 0;
+	pResult->Success = false;
+	pResult->Stopped = false;
+	pResult->ClosedForm = false;
+	pResult->Task = -1;
+	// Nothing has fewer seeds than a polynomial. It takes microseconds, so there's no point checking the clock first.
+	if (pSolver->ClosedForms && SolvePolynomial(Seq, SeqLen, &pResult->Formula, &pResult->Attempt))
+	{
+		pResult->Success = true;
+		pResult->ClosedForm = true;
+		pResult->NumSeeds = 0;
+		pResult->MaxRetroS = 0;
+	}
+	// Every shard solves for it, so that they all skip the same steps and agree on the answer.
+	if (!pResult->Success)
+		FindRecurrence(pSolver, Seq, SeqLen, &Recurrence);
+	// A checkpoint is for one step, so a solve which has anything to do with them searches one step at a time.
+	if (!pResult->Success && pSolver->PortfolioSize > 1 && !Watch.Checkpoints && pCheckpoint == nullptr)
+		SolvePortfolio(pSolver, Seq, SeqLen, FromMaxRetroS, FromAttempt, &Recurrence, ShowProgress, pControl, StartTime, pResult);
+	else
+	{
+		for (MaxRetroS = FromMaxRetroS; !pResult->Success && !pResult->Stopped && MaxRetroS < SeqLen - 2; MaxRetroS++)
+		{
+			// S(i-1) is always allowed, so there would be nothing new to look at.
+			if (MaxRetroS == 1)
+				continue;
+			for (a = MaxRetroS == FromMaxRetroS ? FromAttempt : 0; a < NUM_ATTEMPTS; a++)
+			{
+				if (StepSkipped(&Recurrence, MaxRetroS, a))
+				{
+					if (FirstSkipped.first < 0)
+						FirstSkipped = make_pair(MaxRetroS, a);
+					continue;
+				}
+				// Nothing before it found anything, so it's the answer.
+				if (IsRecurrenceStep(&Recurrence, MaxRetroS, a))
+				{
+					TakeRecurrence(&Recurrence, pResult);
+					break;
+				}
+				pResult->Attempt = a;
+				pResult->MaxRetroS = MaxRetroS;
+				Watch.Progress.Attempt = a;
+				Watch.Progress.MaxRetroS = MaxRetroS;
+				Watch.Progress.MaxItems = Attempts[a].MaxItemsInExpression;
+				Watch.UnitsDone = 0;
+				Watch.NumUnits = 0;
+				if (Watch.Checkpoints)
+				{
+					lock_guard<mutex> Guard(Watch.CheckpointLock);
+
+					Watch.Checkpoint.MaxRetroS = MaxRetroS;
+					Watch.Checkpoint.Attempt = a;
+					Watch.Checkpoint.Tasks.clear();
+					Watch.Checkpoint.FoundTask = -1;
+				}
+				pResume = pCheckpoint != nullptr && pCheckpoint->MaxRetroS == MaxRetroS && pCheckpoint->Attempt == a ? pCheckpoint : nullptr;
+				if (!SearchStopped(pWatch) && SearchStep(pSolver, Seq, SeqLen, a, MaxRetroS, pWatch, pResume, &pResult->Task, &pResult->Formula))
+				{
+					pResult->Success = true;
+					pResult->NumSeeds = CountSeeds(&pResult->Formula);
+				}
+				// If we gave up part way through this step, we've only been all the way through the ones before it.
+				if (Watch.Stopped)
+				{
+					pResult->Stopped = true;
+					if (!pResult->Success)
+						StoppedBefore(MaxRetroS, a, FirstSkipped, pResult);
+				}
+				if (pResult->Success || pResult->Stopped)
+					break;
+				if (ShowProgress)
+					cout << "Hmm...";
+			}
+		}
+	}
+	// The last checkpoint is where it stopped, so nothing's lost.
+	if (pResult->Stopped && Watch.Checkpoints)
+	{
+		lock_guard<mutex> Guard(Watch.CheckpointLock);
+
+		pControl->OnCheckpoint(Watch.Checkpoint);
+	}
+	pResult->ElapsedMs = chrono::duration<double, milli>(chrono::steady_clock::now() - StartTime).count();
+	return pResult->Success;
+}
+
+bool ResumeSolveSequence(sSolver *pSolver, int Seq[], int SeqLen, int FromMaxRetroS, int FromAttempt, bool ShowProgress, const sSolveControl *pControl, sSolveResult *pResult)
+{
+	return SolveFrom(pSolver, Seq, SeqLen, FromMaxRetroS, FromAttempt, nullptr, ShowProgress, pControl, pResult);
+}
+
+bool ResumeFromCheckpoint(sSolver *pSolver, int Seq[], int SeqLen, const sSearchCheckpoint *pCheckpoint, bool ShowProgress, const sSolveControl *pControl, sSolveResult *pResult)
+{
+	// The steps before the checkpoint's have been searched, even if nothing else gets done.
+	pResult->MaxRetroS = pCheckpoint->MaxRetroS;
+	pResult->Attempt = pCheckpoint->Attempt;
+	StepBefore(&pResult->MaxRetroS, &pResult->Attempt);
+	return SolveFrom(pSolver, Seq, SeqLen, pCheckpoint->MaxRetroS, pCheckpoint->Attempt, pCheckpoint, ShowProgress, pControl, pResult);
+}
+
+// The value of "Leaf sum" (or "Leaf prod" if Product) at position i, where Leaf is an S(i-k) or i. Returns false if it's
+// anything else or the total doesn't fit.
+static bool AggregateExactly(bool Product, const sItem *pLeaf, const int Seq[], int i, tExactInt *pResult)
+{
+	tExactInt Total = Product ? 1 : 0;
+	int j;
+
+	if (pLeaf->ItemType == I)
+	{
+		for (j = 1; j <= i; j++)
+		{
+			if (!(Product ? MultiplyExactly(Total, j, &Total) : AddExactly(Total, j, &Total)))
+				return false;
+		}
+	}
+	else if (pLeaf->ItemType == S)
+	{
+		for (j = 0; j <= i - pLeaf->Index - 1; j++)
+		{
+			if (!(Product ? MultiplyExactly(Total, Seq[j], &Total) : AddExactly(Total, Seq[j], &Total)))
+				return false;
+		}
+	}
+	else
+	{
+		return false;
+	}
+	*pResult = Total;
+	return true;
+}
+
+bool FormulaGeneratesSequence(sFormula *pFormula, const int Seq[], int SeqLen)
+{
+	tExactInt Stack[MAX_POSS_ITEMS_IN_EXPRESSION];
+	eOperatorKind Kinds[MAX_POSS_ITEMS_IN_EXPRESSION];
+	const sItem *pItem;
+	int i, inum, Height, FirstPos = CountSeeds(pFormula);
+
+	// A formula which only has seeds to go on doesn't tell us anything.
+	if (FirstPos >= SeqLen)
+		return false;
+	for (inum = 0; inum < pFormula->NumItems; inum++)
+	{
+		if (pFormula->Items[inum].ItemType == OPERATOR && (Kinds[inum] = OperatorKindOf(pFormula->Operators[pFormula->Items[inum].Index])) == NUM_OPERATOR_KINDS)
+			return false;
+	}
+	// Position SeqLen is the next number.
+	for (i = FirstPos; i <= SeqLen; i++)
+	{
+		for (inum = 0, Height = 0; inum < pFormula->NumItems; inum++)
+		{
+			pItem = &pFormula->Items[inum];
+			switch (pItem->ItemType)
+			{
+			case CONSTANT:
+				Stack[Height++] = pItem->Index + 1;
+				break;
+			case I:
+				Stack[Height++] = i;
+				break;
+			case S:
+				Stack[Height++] = Seq[i - pItem->Index - 1];
+				break;
+			case OPERATOR:
+				// Give up as soon as anything doesn't come out whole.
+				if (Height < sOperatorTable::ByKind[Kinds[inum]].NumOperands)
+					return false;
+				if (OperatorAlgebra[Kinds[inum]].Aggregate)
+				{
+					if (inum == 0 || !AggregateExactly(Kinds[inum] == PRODUCT_OP, &pFormula->Items[inum - 1], Seq, i, &Stack[Height - 1]))
+						return false;
+				}
+				else if (sOperatorTable::ByKind[Kinds[inum]].NumOperands == 1)
+				{
+					if (!ApplyOperatorExactly(Kinds[inum], 0, Stack[Height - 1], &Stack[Height - 1]))
+						return false;
+				}
+				else
+				{
+					Height--;
+					if (!ApplyOperatorExactly(Kinds[inum], Stack[Height - 1], Stack[Height], &Stack[Height - 1]))
+						return false;
+				}
+				break;
+			default:
+				return false;
+			}
+		}
+		if (Height != 1 || (i < SeqLen && Stack[0] != Seq[i]))
+			return false;
+	}
+	if (Stack[0] < LLONG_MIN || Stack[0] > LLONG_MAX)
+		return false;
+	pFormula->NextNum = (long long)Stack[0];
+	return true;
+}
+
+const sOperator* const* AttemptOperators(int Attempt, int *pNumOperators)
+{
+	if (Attempt < 0 || Attempt >= NUM_ATTEMPTS)
+		return nullptr;
+	*pNumOperators = Attempts[Attempt].NumOperators;
+	return Attempts[Attempt].Operators;
+}
+
+int AttemptMaxItems(int Attempt)
+{
+	return Attempt >= 0 && Attempt < NUM_ATTEMPTS ? Attempts[Attempt].MaxItemsInExpression : 0;
+}
+
+bool AttemptSearchesFormula(int Attempt, const sFormula *pFormula)
+{
+	return Attempt >= 0 && Attempt < NUM_ATTEMPTS && Attempts[Attempt].pSearched(pFormula->Items, pFormula->NumItems);
+}
+
+// Goes up whenever the search's order or what it skips changes without the attempts changing, e.g. a new pruning rule or
+// the steps a recurrence skips (see StepSkipped()), since that changes the tasks and which formula is found first too.
+#define SEARCH_VERSION	2
+
+unsigned long long AttemptsFingerprint(void)
+{
+	unsigned long long Fingerprint = ((unsigned long long)SEARCH_VERSION << 32) ^ NUM_ATTEMPTS;
+	const char *p;
+	int a, o;
+
+	for (a = 0; a < NUM_ATTEMPTS; a++)
+	{
+		Fingerprint = (Fingerprint ^ Attempts[a].MaxItemsInExpression) * 0x100000001B3ull;
+		for (o = 0; o < Attempts[a].NumOperators; o++)
+		{
+			for (p = Attempts[a].Operators[o]->Display; *p != '\0'; p++)
+				Fingerprint = (Fingerprint ^ (unsigned char)*p) * 0x100000001B3ull;
+			Fingerprint = (Fingerprint ^ ' ') * 0x100000001B3ull;
+		}
+	}
+	return Fingerprint;
+}
+
+int ParseSequence(const string& Line, int Seq[])
+{
+	string s = Line;
+	char *p, *pEnd;
+	char *pContext;
+	long Num;
+	int n;
+
+	for (n = 0, p = strtok_s(&s[0], ", \t\r", &pContext); p != nullptr; p = strtok_s(nullptr, ", \t\r", &pContext))
+	{
+		// All of it has to be the number, and there has to be room for the next number after the last one.
+		errno = 0;
+		Num = strtol(p, &pEnd, 10);
+		if (*pEnd != '\0' || errno == ERANGE || Num < INT_MIN || Num > INT_MAX || n == MAX_SEQ_LEN - 1)
+			return -1;
+		Seq[n++] = (int)Num;
+	}
+	return n;
+}
@@ -0,0 +1,184 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <string>
+#include <vector>
+
+typedef enum { CONSTANT, S, I, OPERATOR, NUM_ITEM_TYPES } eItemType; // Don't change order.
+
+#define MAX_POSS_ITEMS_IN_EXPRESSION	20	// Beyond that and it would probably take a very long time.
+#define MAX_SEQ_LEN	50 // Number of numbers in a sequence e.g. 1+2*3 makes 5 items. This includes a "space" for the next number at the end.
+
+// What the user needs to know about an operator. What it actually does is in Operators.h.
+typedef struct {
+	const char	*Display;	// How we display this operation on the console, e.g. "+".
+	int			NumOperands;
+} sOperator;
+
+typedef struct {
+	eItemType	ItemType;
+	int			Index;
+} sItem;
+
+// A formula which fits the user's sequence, and the number it says comes next.
+typedef struct {
+	sItem				Items[MAX_POSS_ITEMS_IN_EXPRESSION];
+	int					NumItems;
+	const sOperator* const*	Operators;	// The operator set which the OPERATOR items' indices refer to.
+	long long			NextNum;	// Worked out with whole numbers, so it's exact.
+} sFormula;
+
+// How SolveSequence() looks for the formula.
+typedef enum {
+	DEPTH_FIRST_ENGINE,	// Walks through the formulae one at a time, skipping the ones CheckOperatorValidHere() knows are repeats.
+	BOTTOM_UP_ENGINE	// Builds expressions up smallest first, keeping one for each different set of values. See BottomUp.h.
+} eSearchEngine;
+
+// What SolveSequence() found out about a sequence.
+typedef struct {
+	bool		Success;
+	sFormula	Formula;	// Only filled in if Success.
+	int			NumSeeds;	// How many numbers at the start of the sequence the formula can't generate because it refers back before them.
+	int			Attempt;	// Which of the attempts found the formula, 0 being the first and quickest.
+	int			MaxRetroS;	// How far back in the sequence the search was allowed to look when it found the formula.
+						// If there's no formula, Attempt and MaxRetroS say the last step which was searched (-1 if none).
+	bool		ClosedForm;	// It's a polynomial or a linear recurrence, which was solved for rather than searched for (see
+						// ClosedForm.h), so Attempt and MaxRetroS only say which step it belongs in, not that all the
+						// steps before it were searched.
+	int			Task;		// Which of the step's depth first search tasks found it, or -1 if it wasn't the depth first search.
+						// Shards' results go in the order (MaxRetroS, Attempt, Task) (see sSolver::NumShards).
+	bool		Stopped;	// It ran out of time or was cancelled (see sSolveControl) before it finished. If there's a formula,
+						// it fits, but the search hadn't finished ruling out the simpler ones. If not, Attempt and MaxRetroS
+						// say the last step it got all the way through (-1 if none), which a later solve can carry on from.
+	double		ElapsedMs;
+} sSolveResult;
+
+// How a solve is getting on, for sSolveControl::OnProgress.
+typedef struct {
+	int			Attempt;	// The step being searched.
+	int			MaxRetroS;
+	int			MaxItems;	// The longest formulae the attempt looks at.
+	double		Fraction;	// Roughly how much of the step has been searched, from 0 to 1.
+	double		ElapsedMs;	// Since the solve started.
+} sSolveProgress;
+
+// Where one of a step's depth first search tasks had got to.
+typedef enum { TASK_NOT_STARTED, TASK_STARTED, TASK_DONE } eTaskStatus;
+
+typedef struct {
+	eTaskStatus	Status;
+	// If it's TASK_STARTED, the last formula it had finished with, and whether it was going to go on to the longer ones which
+	// start with it. That, the step and the task's first formula are all there is to where a depth first search is.
+	sItem		Items[MAX_POSS_ITEMS_IN_EXPRESSION];
+	int			NumItems;
+	int			StackHeight;
+	bool		ItemValid;
+} sTaskCheckpoint;
+
+// Enough to carry on with a solve from where it was stopped (or the process was killed), rather than from the start.
+typedef struct {
+	int			MaxRetroS;	// The step it had got to. The ones before it had nothing in them.
+	int			Attempt;
+	std::vector<sTaskCheckpoint>	Tasks;	// Where the step's depth first search tasks had got to. Empty if it hadn't started them.
+	int			FoundTask;	// The lowest of them which had found a fit, which is Found, or -1. Only the ones before it still
+	sFormula	Found;		// need finishing.
+} sSearchCheckpoint;
+
+// Optional limits on a solve, and a way to keep an eye on it. Anything left at 0 or empty isn't used.
+typedef struct {
+	double	TimeLimitMs;				// Give up after this long.
+	const std::atomic<bool>	*pCancel;	// Give up soon after this becomes true, e.g. when another thread sets it.
+	double	ProgressIntervalMs;			// How often to call OnProgress, which is called from one of the search's threads.
+	std::function<void(const sSolveProgress& Progress)>	OnProgress;
+	double	CheckpointIntervalMs;		// How often to call OnCheckpoint, which is also called from one of the search's threads,
+	std::function<void(const sSearchCheckpoint& Checkpoint)>	OnCheckpoint;	// and once more if the solve is stopped.
+} sSolveControl;
+
+// How much work the depth first search did turning down formulae.
+typedef struct {
+	unsigned long long	Rejected;			// Formulae which were checked against the sequence and didn't fit it.
+} sRejectionStats;
+
+struct sFormulaLibrary;
+
+// How to solve sequences, and how much work it's taken so far. Nothing else a solve uses changes (the attempts and their
+// operators are fixed when it's compiled), so solves with different solvers can run at once on different threads without
+// getting in each other's way, e.g. one for each of batch mode's workers. A solver only does one solve at a time, though
+// that solve can use several threads.
+typedef struct {
+	eSearchEngine	Engine;
+	int				NumThreads;			// How many threads a solve may use. The bottom-up engine only uses one.
+	const sFormulaLibrary	*pLibrary;	// Where to look for formulae with no seeds before searching, or nullptr.
+	bool			ClosedForms;		// Whether to solve for polynomials and linear recurrences (see ClosedForm.h) as well as searching.
+	// The depth first search's tasks are numbered in the order it would get to them, so a step can be split into NumShards
+	// runs of tasks, for that many solves (e.g. in processes on different machines) to share out. This solve only does run
+	// Shard (from 0), and the others' results go with its in the order of sSolveResult::Task to give the whole search's
+	// answer. Shard 0 does anything else a step does, e.g. the library and the meet-in-the-middle attempt, and the steps
+	// don't use the bottom-up engine, since its answers don't go in that order.
+	int				Shard;
+	int				NumShards;
+	// How many steps to search at once, each with its share of NumThreads, so that a formula in a later step doesn't have to
+	// wait for the steps before it to be searched one after another. As soon as a step finds a formula, the steps after it
+	// are stopped, and once the ones before it have all finished it's the answer, the same as searching them in order would
+	// give. A portfolio solve doesn't call OnProgress or OnCheckpoint, since there's no one step it's on, so a solve with an
+	// OnCheckpoint, or carrying on from a checkpoint, searches one step at a time. 1 for one at a time.
+	int				PortfolioSize;
+	sRejectionStats	Rejections;			// Added up over every solve so far.
+} sSolver;
+
+// Sets up a solver with no library, which solves for closed forms first, does all of the search one step at a time and
+// hasn't done anything yet.
+void InitSolver(sSolver *pSolver, eSearchEngine Engine, int NumThreads);
+
+// Works out the formula behind the sequence, trying short formulae with few seeds first and working up to longer ones.
+// If pSolver->ClosedForms and the sequence is a polynomial, that's the answer, and nothing gets searched (see
+// sSolveResult::ClosedForm). A linear recurrence is only the answer if the steps before the one it belongs in find nothing,
+// and the ones with fewer seeds are only searched up to its attempt.
+// If ShowProgress, we tell the user about each attempt that fails. pControl (nullptr for none) can limit how long it takes.
+// Returns pResult->Success.
+bool SolveSequence(sSolver *pSolver, int Seq[], int SeqLen, bool ShowProgress, const sSolveControl *pControl, sSolveResult *pResult);
+
+// The same as SolveSequence(), but starts at attempt FromAttempt with MaxRetroS FromMaxRetroS, for when we already know
+// there's nothing to find before that (e.g. because it's true of a shorter sequence which this one starts with). If it
+// doesn't search anything, pResult->Attempt and MaxRetroS are left as they were.
+bool ResumeSolveSequence(sSolver *pSolver, int Seq[], int SeqLen, int FromMaxRetroS, int FromAttempt, bool ShowProgress, const sSolveControl *pControl, sSolveResult *pResult);
+
+// The same as ResumeSolveSequence(), but carries on from a checkpoint which an earlier solve of the same sequence, with the
+// same attempts and shard, gave its OnCheckpoint, including the depth first search's tasks which were part way through.
+bool ResumeFromCheckpoint(sSolver *pSolver, int Seq[], int SeqLen, const sSearchCheckpoint *pCheckpoint, bool ShowProgress, const sSolveControl *pControl, sSolveResult *pResult);
+
+// One step of SolveSequence(): searches for a formula which fits the sequence using only the operators and maximum length
+// of attempt Attempt, and looking back no further than S(i-MaxRetroS). Like SolveSequence(), it only looks at the formulae
+// which the steps before it (fewer S(i-k), or earlier attempts) didn't. It never solves for a closed form.
+bool GuessSequence(sSolver *pSolver, int Seq[], int SeqLen, int Attempt, int MaxRetroS, sFormula *pFound);
+
+// Checks whether the formula generates the sequence, and if so puts the number after it in NextNum. Unlike the search,
+// which uses doubles to be quick, this works with whole numbers, so it can't be fooled by rounding, and it doesn't accept
+// any step which doesn't come out whole, e.g. 7 / 2. Everything the search finds gets checked with this before we believe it.
+bool FormulaGeneratesSequence(sFormula *pFormula, const int Seq[], int SeqLen);
+
+// The operators which the formulae found by Attempt use, and how many there are, or nullptr if there's no such attempt.
+const sOperator* const* AttemptOperators(int Attempt, int *pNumOperators);
+
+// The most items attempt Attempt's formulae can have, or 0 if there's no such attempt.
+int AttemptMaxItems(int Attempt);
+
+// Whether attempt Attempt's depth first search looks at the formula, rather than skipping it because it's the same as
+// another one, e.g. "2 3 +" is just "5". Its operators must be attempt Attempt's.
+bool AttemptSearchesFormula(int Attempt, const sFormula *pFormula);
+
+// A number which changes whenever the attempts or the order they're searched in do, so results saved by an older build can
+// be recognised.
+unsigned long long AttemptsFingerprint(void);
+
+// Formats the formula in reverse polish e.g. "S(i-1) S(i-2) +".
+std::string FormulaToString(const sFormula *pFormula);
+
+// Shows the user the formula.
+void SpitFormula(const sFormula *pFormula);
+
+// Reads a sequence of numbers separated by commas or whitespace into Seq[] and returns how many there were. Returns -1 if
+// something in it isn't a whole number which fits in an int, or there are more than MAX_SEQ_LEN - 1 numbers, since we need
+// a space for the next number.
+int ParseSequence(const std::string& Line, int Seq[]);
@@ -0,0 +1,83 @@
+#include "stdafx.h"
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "WorkStealingPool.h"
+using namespace std;
+
+typedef struct {
+	mutex		Lock;
+	deque<int>	Tasks;
+} sWorkerQueue;
+
+// Takes the lowest-numbered task from our own queue, or failing that the highest-numbered task from somebody else's.
+// Returns -1 when there's nothing left anywhere.
+static int GetTask(vector<sWorkerQueue>& Queues, int ThreadNum)
+{
+	int t, Victim, TaskNum;
+
+	{
+		lock_guard<mutex> Guard(Queues[ThreadNum].Lock);
+		if (!Queues[ThreadNum].Tasks.empty())
+		{
+			TaskNum = Queues[ThreadNum].Tasks.front();
+			Queues[ThreadNum].Tasks.pop_front();
+			return TaskNum;
+		}
+	}
+	// Our own queue is empty so steal. Start with our neighbour so that the thieves spread themselves over the victims.
+	for (t = 1; t < (int)Queues.size(); t++)
+	{
+		Victim = (ThreadNum + t) % Queues.size();
+		lock_guard<mutex> Guard(Queues[Victim].Lock);
+		if (!Queues[Victim].Tasks.empty())
+		{
+			TaskNum = Queues[Victim].Tasks.back();
+			Queues[Victim].Tasks.pop_back();
+			return TaskNum;
+		}
+	}
+	return -1;
+}
+
+void RunTasksWorkStealing(int NumTasks, int NumThreads, const function<void(int TaskNum, int ThreadNum)>& TaskFn)
+{
+	vector<thread> Threads;
+	int t, TaskNum;
+
+	if (NumThreads > NumTasks)
+		NumThreads = NumTasks;
+	if (NumThreads <= 1)
+	{
+		// Not worth starting any threads.
+		for (TaskNum = 0; TaskNum < NumTasks; TaskNum++)
+			TaskFn(TaskNum, 0);
+		return;
+	}
+
+	// Deal out the tasks in contiguous blocks, so thread 0 gets the first block, which contains the tasks we most want finished.
+	vector<sWorkerQueue> Queues(NumThreads);
+	for (TaskNum = 0; TaskNum < NumTasks; TaskNum++)
+	{
+		Queues[(long long)TaskNum * NumThreads / NumTasks].Tasks.push_back(TaskNum);
+	}
+	for (t = 0; t < NumThreads; t++)
+	{
+		Threads.emplace_back([&Queues, &TaskFn, t]()
+		{
+			int TaskNum;
+			while ((TaskNum = GetTask(Queues, t)) >= 0)
+				TaskFn(TaskNum, t);
+		});
+	}
+	for (t = 0; t < NumThreads; t++)
+		Threads[t].join();
+}
+
+int DefaultNumThreads(void)
+{
+	unsigned int n = thread::hardware_concurrency();
+
+	return n >= 1 ? (int)n : 1;
+}
@@ -0,0 +1,14 @@
+#pragma once
+
+#include <functional>
+
+// Runs tasks 0..NumTasks-1 across NumThreads worker threads and returns once they have all been run (or skipped).
+// Each worker starts with its own contiguous block of task numbers, which it works through lowest-first. A worker which
+// runs out of work steals the highest-numbered task left in another worker's block, so low-numbered tasks tend to be
+// finished first, which is what the callers want because they're usually looking for the first task that succeeds.
+// TaskFn is called as TaskFn(TaskNum, ThreadNum). ThreadNum is in 0..NumThreads-1 so callers can keep per-thread scratch
+// space in a plain array indexed by it.
+void RunTasksWorkStealing(int NumTasks, int NumThreads, const std::function<void(int TaskNum, int ThreadNum)>& TaskFn);
+
+// How many threads to use by default. Never less than 1.
+int DefaultNumThreads(void);
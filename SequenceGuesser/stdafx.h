@@ -5,10 +5,16 @@
 
 #pragma once
 
-#include "targetver.h"
-
 #include <stdio.h>
+
+#ifdef _WIN32
+#include "targetver.h"
 #include <tchar.h>
+#else
+#include <string.h>
+// The same thing by its POSIX name.
+#define strtok_s strtok_r
+#endif
 
 
 